@@ -0,0 +1,500 @@
+// Набор замеров SearchServer: задержки отдельных операций (p50/p99/p999) и пропускная способность
+// на корпусах разного размера. Результат — JSON; с --baseline результаты сравниваются с сохранёнными,
+// и при регрессии программа завершается с кодом 1. Замеры, где меньше --min-samples операций
+// в текущем прогоне или в базе, выводятся, но не проверяются: одна операция — это шум, а не медиана.
+//
+// Сборка из каталога search-server:
+//     g++ -std=c++17 -O2 -I. -o search_server_benchmark benchmark/search_server_benchmark.cpp
+//         $(ls *.cpp | grep -v -e main.cpp -e test_example -e read_input -e request_queue) -ltbb -lpthread
+// Запуск:
+//     ./search_server_benchmark --sizes 10000,100000 --output current.json --baseline benchmark/baseline.json
+// Корпус из 10M документов по умолчанию занимает порядка 10 ГБ; для него стоит уменьшить --max-words
+
+#include "search_server.h"
+#include "process_queries.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <execution>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct Options {
+    vector<size_t> corpus_sizes = {10'000, 100'000};
+    size_t query_count = 1000;
+    int dictionary_size = 10'000;
+    int max_document_words = 20;
+    uint32_t seed = 1;
+    string output_path;
+    string baseline_path;
+    // Допустимое ухудшение p50 и пропускной способности относительно базы
+    double tolerance = 0.15;
+    size_t min_sample_count = 10;
+};
+
+struct Measurement {
+    string name;
+    size_t corpus_size;
+    size_t sample_count;
+    double p50_us;
+    double p99_us;
+    double p999_us;
+    // Операций в секунду; для пакетных замеров — документов или запросов
+    double throughput;
+};
+
+using Clock = chrono::steady_clock;
+
+// Перцентиль по ближайшему рангу
+double GetPercentile(const vector<double>& sorted_samples, double quantile) {
+    if (sorted_samples.empty()) {
+        return 0.0;
+    }
+    const size_t rank = static_cast<size_t>(ceil(quantile * sorted_samples.size()));
+    return sorted_samples[min(sorted_samples.size(), max<size_t>(rank, 1)) - 1];
+}
+
+// Задержки операций одного замера в микросекундах
+class LatencyRecorder {
+public:
+    template <typename Operation>
+    void Time(Operation operation) {
+        const auto start = Clock::now();
+        operation();
+        samples_us_.push_back(chrono::duration<double, micro>(Clock::now() - start).count());
+    }
+
+    // item_count — сколько единиц работы выполнено за все операции; 0 — по одной на операцию
+    Measurement Summarize(string name, size_t corpus_size, size_t item_count = 0) {
+        sort(samples_us_.begin(), samples_us_.end());
+        double total_us = 0.0;
+        for (const double sample : samples_us_) {
+            total_us += sample;
+        }
+        if (item_count == 0) {
+            item_count = samples_us_.size();
+        }
+        const double throughput = total_us > 0.0 ? item_count / (total_us / 1e6) : 0.0;
+        return {move(name), corpus_size, samples_us_.size(),
+                GetPercentile(samples_us_, 0.5), GetPercentile(samples_us_, 0.99), GetPercentile(samples_us_, 0.999),
+                throughput};
+    }
+
+private:
+    vector<double> samples_us_;
+};
+
+string GenerateWord(mt19937& generator, int max_length) {
+    const int length = uniform_int_distribution(1, max_length)(generator);
+    string word;
+    word.reserve(length);
+    for (int i = 0; i < length; ++i) {
+        word.push_back(uniform_int_distribution('a', 'z')(generator));
+    }
+    return word;
+}
+
+vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
+    vector<string> words;
+    words.reserve(word_count);
+    for (int i = 0; i < word_count; ++i) {
+        words.push_back(GenerateWord(generator, max_length));
+    }
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    return words;
+}
+
+// Слова выбираются по закону Ципфа, как в естественном языке: частые термы дают длинные списки вхождений
+class WordSampler {
+public:
+    explicit WordSampler(const vector<string>& dictionary)
+            : dictionary_(dictionary)
+    {
+        vector<double> weights(dictionary.size());
+        for (size_t i = 0; i < weights.size(); ++i) {
+            weights[i] = 1.0 / (i + 1);
+        }
+        distribution_ = discrete_distribution<size_t>(weights.begin(), weights.end());
+    }
+
+    const string& operator()(mt19937& generator) {
+        return dictionary_[distribution_(generator)];
+    }
+
+private:
+    const vector<string>& dictionary_;
+    discrete_distribution<size_t> distribution_;
+};
+
+string GenerateText(mt19937& generator, WordSampler& sampler, int word_count, double minus_prob = 0.0) {
+    string text;
+    for (int i = 0; i < word_count; ++i) {
+        if (!text.empty()) {
+            text.push_back(' ');
+        }
+        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            text.push_back('-');
+        }
+        text += sampler(generator);
+    }
+    return text;
+}
+
+vector<string> GenerateQueries(mt19937& generator, WordSampler& sampler, size_t query_count, int word_count, double minus_prob = 0.0) {
+    vector<string> queries;
+    queries.reserve(query_count);
+    for (size_t i = 0; i < query_count; ++i) {
+        queries.push_back(GenerateText(generator, sampler, word_count, minus_prob));
+    }
+    return queries;
+}
+
+// filter — необязательный предикат, статус или DocumentFilter
+template <typename Policy, typename... Filter>
+void MeasureFindTopDocuments(const SearchServer& search_server, const Policy& policy, string name,
+                             const vector<string>& queries, vector<Measurement>& measurements, const Filter&... filter) {
+    LatencyRecorder recorder;
+    for (const string& query : queries) {
+        recorder.Time([&] {
+            search_server.FindTopDocuments(policy, query, filter...);
+        });
+    }
+    measurements.push_back(recorder.Summarize(move(name), search_server.GetDocumentCount()));
+}
+
+template <typename Policy>
+void MeasureMatchDocument(const SearchServer& search_server, const Policy& policy, string name,
+                          const vector<string>& queries, const vector<int>& document_ids, vector<Measurement>& measurements) {
+    LatencyRecorder recorder;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        recorder.Time([&] {
+            search_server.MatchDocument(policy, queries[i], document_ids[i % document_ids.size()]);
+        });
+    }
+    measurements.push_back(recorder.Summarize(move(name), search_server.GetDocumentCount()));
+}
+
+void RunCorpus(const Options& options, size_t corpus_size, vector<Measurement>& measurements) {
+    mt19937 generator(options.seed);
+    const vector<string> dictionary = GenerateDictionary(generator, options.dictionary_size, 10);
+    WordSampler sampler(dictionary);
+    // Самые частые слова словаря — стоп-слова
+    const string stop_words = dictionary[0] + ' ' + dictionary[1] + ' ' + dictionary[2];
+
+    vector<string> texts;
+    texts.reserve(corpus_size);
+    for (size_t i = 0; i < corpus_size; ++i) {
+        texts.push_back(GenerateText(generator, sampler, uniform_int_distribution(1, options.max_document_words)(generator)));
+    }
+    // Рейтинги различаются, чтобы фильтр по диапазону рейтинга отсекал часть документов
+    const auto get_ratings = [](size_t document_id) {
+        return vector<int>{static_cast<int>(document_id % 10)};
+    };
+    const auto get_status = [](size_t document_id) {
+        return static_cast<DocumentStatus>(document_id % 4 == 3 ? 1 : 0);
+    };
+
+    cerr << "corpus "s << corpus_size << ": ingest"s << endl;
+    {
+        // Корпус делится на INGEST_BATCH_COUNT пакетов, чтобы и у малого корпуса хватало замеров для сравнения с базой
+        constexpr size_t INGEST_BATCH_COUNT = 20;
+        const size_t batch_size = max<size_t>(1, corpus_size / INGEST_BATCH_COUNT);
+        LatencyRecorder recorder;
+        SearchServer batch_server(stop_words);
+        vector<NewDocument> batch;
+        for (size_t first = 0; first < corpus_size; first += batch_size) {
+            batch.clear();
+            for (size_t i = first; i < min(corpus_size, first + batch_size); ++i) {
+                batch.push_back({static_cast<int>(i), texts[i], get_status(i), get_ratings(i)});
+            }
+            recorder.Time([&] {
+                batch_server.AddDocuments(batch);
+            });
+        }
+        measurements.push_back(recorder.Summarize("ingest/add_documents_batch"s, corpus_size, corpus_size));
+    }
+    SearchServer search_server(stop_words);
+    {
+        LatencyRecorder recorder;
+        for (size_t i = 0; i < corpus_size; ++i) {
+            const vector<int> ratings = get_ratings(i);
+            recorder.Time([&] {
+                search_server.AddDocument(static_cast<int>(i), texts[i], get_status(i), ratings);
+            });
+        }
+        measurements.push_back(recorder.Summarize("ingest/add_document"s, corpus_size));
+    }
+
+    cerr << "corpus "s << corpus_size << ": queries"s << endl;
+    for (const int term_count : {1, 4, 16, 64}) {
+        const vector<string> queries = GenerateQueries(generator, sampler, options.query_count, term_count);
+        const string suffix = "/terms="s + to_string(term_count);
+        MeasureFindTopDocuments(search_server, execution::seq, "find_top/seq"s + suffix, queries, measurements);
+        MeasureFindTopDocuments(search_server, execution::par, "find_top/par"s + suffix, queries, measurements);
+        MeasureFindTopDocuments(search_server, search_policy::max_score, "find_top/max_score"s + suffix, queries, measurements);
+    }
+    const vector<string> minus_queries = GenerateQueries(generator, sampler, options.query_count, 16, 0.25);
+    MeasureFindTopDocuments(search_server, execution::seq, "find_top/seq/terms=16/minus"s, minus_queries, measurements);
+    MeasureFindTopDocuments(search_server, execution::par, "find_top/par/terms=16/minus"s, minus_queries, measurements);
+    MeasureFindTopDocuments(search_server, search_policy::max_score, "find_top/max_score/terms=16/minus"s, minus_queries, measurements);
+
+    // Декларативный фильтр против равносильного ему предиката
+    const vector<string> filter_queries = GenerateQueries(generator, sampler, options.query_count, 16);
+    MeasureFindTopDocuments(search_server, execution::seq, "find_top/seq/terms=16/status_predicate"s, filter_queries, measurements,
+                            [](int, DocumentStatus status, int) { return status == DocumentStatus::ACTUAL; });
+    MeasureFindTopDocuments(search_server, execution::seq, "find_top/seq/terms=16/status_filter"s, filter_queries, measurements,
+                            DocumentFilter{DocumentStatus::ACTUAL, nullopt, nullopt});
+    MeasureFindTopDocuments(search_server, execution::seq, "find_top/seq/terms=16/rating_predicate"s, filter_queries, measurements,
+                            [](int, DocumentStatus status, int rating) {
+                                return status == DocumentStatus::ACTUAL && rating >= 2 && rating <= 5;
+                            });
+    MeasureFindTopDocuments(search_server, execution::seq, "find_top/seq/terms=16/rating_filter"s, filter_queries, measurements,
+                            DocumentFilter{DocumentStatus::ACTUAL, 2, 5});
+
+    vector<int> document_ids(options.query_count);
+    for (int& document_id : document_ids) {
+        document_id = uniform_int_distribution<int>(0, static_cast<int>(corpus_size) - 1)(generator);
+    }
+    MeasureMatchDocument(search_server, execution::seq, "match_document/seq/terms=16/minus"s, minus_queries, document_ids, measurements);
+    MeasureMatchDocument(search_server, execution::par, "match_document/par/terms=16/minus"s, minus_queries, document_ids, measurements);
+
+    {
+        constexpr size_t QUERY_BATCH = 100;
+        const vector<string> queries = GenerateQueries(generator, sampler, options.query_count, 16);
+        LatencyRecorder recorder;
+        for (size_t first = 0; first < queries.size(); first += QUERY_BATCH) {
+            const auto last = queries.begin() + min(queries.size(), first + QUERY_BATCH);
+            recorder.Time([&] {
+                ProcessQueries(search_server, queries.begin() + first, last);
+            });
+        }
+        measurements.push_back(recorder.Summarize("process_queries/batch=100/terms=16"s, corpus_size, queries.size()));
+    }
+
+    cerr << "corpus "s << corpus_size << ": removal"s << endl;
+    {
+        // Удаляется 1% корпуса, но не меньше 100 документов
+        vector<int> removed_ids(max<size_t>(100, corpus_size / 100));
+        for (int& document_id : removed_ids) {
+            document_id = uniform_int_distribution<int>(0, static_cast<int>(corpus_size) - 1)(generator);
+        }
+        sort(removed_ids.begin(), removed_ids.end());
+        removed_ids.erase(unique(removed_ids.begin(), removed_ids.end()), removed_ids.end());
+        shuffle(removed_ids.begin(), removed_ids.end(), generator);
+        LatencyRecorder recorder;
+        for (const int document_id : removed_ids) {
+            recorder.Time([&] {
+                search_server.RemoveDocument(document_id);
+            });
+        }
+        measurements.push_back(recorder.Summarize("remove_document"s, corpus_size));
+    }
+
+    cerr << "corpus "s << corpus_size << ": churn"s << endl;
+    {
+        // Замена документов в сжатом индексе: несколько раундов, в каждом удаляется и добавляется 1% корпуса
+        constexpr int ROUND_COUNT = 5;
+        const size_t churn_count = max<size_t>(100, corpus_size / 100);
+        search_server.SetPostingCompression(true);
+        vector<int> live_ids(search_server.begin(), search_server.end());
+        int next_id = static_cast<int>(corpus_size);
+        LatencyRecorder remove_recorder;
+        LatencyRecorder add_recorder;
+        for (int round = 0; round < ROUND_COUNT; ++round) {
+            for (size_t i = 0; i < churn_count && !live_ids.empty(); ++i) {
+                swap(live_ids[uniform_int_distribution<size_t>(0, live_ids.size() - 1)(generator)], live_ids.back());
+                const int document_id = live_ids.back();
+                live_ids.pop_back();
+                remove_recorder.Time([&] {
+                    search_server.RemoveDocument(document_id);
+                });
+            }
+            for (size_t i = 0; i < churn_count; ++i) {
+                const int document_id = next_id++;
+                const vector<int> ratings = get_ratings(document_id);
+                add_recorder.Time([&] {
+                    search_server.AddDocument(document_id, texts[document_id % corpus_size], get_status(document_id), ratings);
+                });
+                live_ids.push_back(document_id);
+            }
+        }
+        measurements.push_back(remove_recorder.Summarize("churn/compressed/remove_document"s, corpus_size));
+        measurements.push_back(add_recorder.Summarize("churn/compressed/add_document"s, corpus_size));
+    }
+}
+
+void WriteJson(ostream& out, const vector<Measurement>& measurements) {
+    out << "{\n  \"results\": [\n"s;
+    for (size_t i = 0; i < measurements.size(); ++i) {
+        const Measurement& measurement = measurements[i];
+        out << "    {\"name\": \""s << measurement.name << "\", \"corpus_size\": "s << measurement.corpus_size
+            << ", \"samples\": "s << measurement.sample_count << fixed << setprecision(3)
+            << ", \"p50_us\": "s << measurement.p50_us << ", \"p99_us\": "s << measurement.p99_us
+            << ", \"p999_us\": "s << measurement.p999_us << ", \"throughput_per_s\": "s << measurement.throughput
+            << '}' << (i + 1 < measurements.size() ? ","s : ""s) << '\n';
+        out.unsetf(ios::floatfield);
+    }
+    out << "  ]\n}\n"s;
+}
+
+double ReadNumberField(const string& line, const string& field) {
+    const size_t pos = line.find("\""s + field + "\": "s);
+    if (pos == string::npos) {
+        throw invalid_argument("В базе нет поля "s + field + ": "s + line);
+    }
+    return strtod(line.c_str() + pos + field.size() + 4, nullptr);
+}
+
+// Читает файл, записанный WriteJson: по одному результату на строку
+vector<Measurement> ReadBaseline(const string& path) {
+    ifstream in(path);
+    if (!in) {
+        throw runtime_error("Не удалось открыть базу замеров: "s + path);
+    }
+    vector<Measurement> measurements;
+    const string name_prefix = "{\"name\": \""s;
+    for (string line; getline(in, line);) {
+        const size_t name_pos = line.find(name_prefix);
+        if (name_pos == string::npos) {
+            continue;
+        }
+        const size_t name_begin = name_pos + name_prefix.size();
+        Measurement measurement;
+        measurement.name = line.substr(name_begin, line.find('"', name_begin) - name_begin);
+        measurement.corpus_size = static_cast<size_t>(ReadNumberField(line, "corpus_size"s));
+        measurement.sample_count = static_cast<size_t>(ReadNumberField(line, "samples"s));
+        measurement.p50_us = ReadNumberField(line, "p50_us"s);
+        measurement.p99_us = ReadNumberField(line, "p99_us"s);
+        measurement.p999_us = ReadNumberField(line, "p999_us"s);
+        measurement.throughput = ReadNumberField(line, "throughput_per_s"s);
+        measurements.push_back(move(measurement));
+    }
+    return measurements;
+}
+
+// Возвращает число регрессий. p99 и p999 шумнее медианы, поэтому они выводятся, но не проверяются.
+// Замер, где меньше min_sample_count операций, тоже только выводится
+size_t CompareWithBaseline(const vector<Measurement>& measurements, const vector<Measurement>& baseline, double tolerance,
+                           size_t min_sample_count) {
+    map<pair<string, size_t>, const Measurement*> baseline_index;
+    for (const Measurement& measurement : baseline) {
+        baseline_index[{measurement.name, measurement.corpus_size}] = &measurement;
+    }
+    size_t regression_count = 0;
+    for (const Measurement& measurement : measurements) {
+        const auto it = baseline_index.find({measurement.name, measurement.corpus_size});
+        if (it == baseline_index.end()) {
+            continue;
+        }
+        const Measurement& base = *it->second;
+        const bool is_gated = min(measurement.sample_count, base.sample_count) >= min_sample_count;
+        const bool is_regression = is_gated
+                                   && (measurement.p50_us > base.p50_us * (1.0 + tolerance)
+                                       || measurement.throughput < base.throughput * (1.0 - tolerance));
+        regression_count += is_regression;
+        cerr << (is_regression ? "REGRESSION "s : is_gated ? "ok         "s : "skipped    "s)
+             << measurement.name << " @" << measurement.corpus_size
+             << fixed << setprecision(1)
+             << ": p50 "s << base.p50_us << " -> "s << measurement.p50_us << " us"s
+             << ", p99 "s << base.p99_us << " -> "s << measurement.p99_us << " us"s
+             << ", throughput "s << base.throughput << " -> "s << measurement.throughput << "/s"s
+             << ", samples "s << base.sample_count << " -> "s << measurement.sample_count << endl;
+        cerr.unsetf(ios::floatfield);
+    }
+    return regression_count;
+}
+
+vector<size_t> ParseSizes(const string& text) {
+    vector<size_t> sizes;
+    stringstream in(text);
+    for (string size; getline(in, size, ',');) {
+        sizes.push_back(stoull(size));
+    }
+    return sizes;
+}
+
+Options ParseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (i + 1 >= argc) {
+            throw invalid_argument("Нет значения для "s + arg);
+        }
+        const string value = argv[++i];
+        if (arg == "--sizes"s) {
+            options.corpus_sizes = ParseSizes(value);
+        } else if (arg == "--queries"s) {
+            options.query_count = stoull(value);
+        } else if (arg == "--dictionary"s) {
+            options.dictionary_size = stoi(value);
+        } else if (arg == "--max-words"s) {
+            options.max_document_words = stoi(value);
+        } else if (arg == "--seed"s) {
+            options.seed = static_cast<uint32_t>(stoul(value));
+        } else if (arg == "--output"s) {
+            options.output_path = value;
+        } else if (arg == "--baseline"s) {
+            options.baseline_path = value;
+        } else if (arg == "--tolerance"s) {
+            options.tolerance = stod(value);
+        } else if (arg == "--min-samples"s) {
+            options.min_sample_count = stoull(value);
+        } else {
+            throw invalid_argument("Неизвестный параметр "s + arg);
+        }
+    }
+    if (options.query_count == 0 || options.max_document_words < 1 || options.dictionary_size < 4) {
+        throw invalid_argument("Некорректные параметры замера"s);
+    }
+    return options;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        const Options options = ParseOptions(argc, argv);
+        vector<Measurement> measurements;
+        for (const size_t corpus_size : options.corpus_sizes) {
+            RunCorpus(options, corpus_size, measurements);
+        }
+
+        if (options.output_path.empty()) {
+            WriteJson(cout, measurements);
+        } else {
+            ofstream out(options.output_path);
+            WriteJson(out, measurements);
+            if (!out) {
+                throw runtime_error("Не удалось записать результаты: "s + options.output_path);
+            }
+        }
+
+        if (!options.baseline_path.empty()) {
+            const size_t regression_count = CompareWithBaseline(measurements, ReadBaseline(options.baseline_path), options.tolerance,
+                                                                 options.min_sample_count);
+            if (regression_count > 0) {
+                cerr << regression_count << " regressions"s << endl;
+                return 1;
+            }
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include "cached_search_server.h"
+
+namespace {
+
+template <typename T>
+void AppendBytes(std::string& key, const T& value) {
+    key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+} // namespace
+
+CachedSearchServer::CachedSearchServer(const SearchServer& search_server, size_t capacity, size_t shard_count)
+        : search_server_(search_server)
+        , shard_capacity_(std::max<size_t>(1, capacity / std::max<size_t>(1, shard_count)))
+        , shards_(std::max<size_t>(1, shard_count))
+{}
+
+std::vector<Document> CachedSearchServer::FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter, size_t max_count) {
+    const auto query = search_server_.ParseQuery(raw_query);
+    const uint64_t generation = search_server_.GetGeneration();
+    std::string key = MakeKey(query, filter, max_count);
+    Shard& shard = shards_[std::hash<std::string>{}(key) % shards_.size()];
+
+    {
+        std::lock_guard guard(shard.mutex);
+        SyncGeneration(shard, generation);
+        const auto it = shard.key_to_entry.find(key);
+        if (it != shard.key_to_entry.end()) {
+            shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+            ++hit_count_;
+            return it->second->second;
+        }
+    }
+    ++miss_count_;
+
+    // Поиск идёт без блокировки, чтобы промахи не задерживали другие запросы той же части
+    auto documents = search_server_.SearchFilteredDocuments(std::execution::seq, query, filter, max_count);
+
+    std::lock_guard guard(shard.mutex);
+    SyncGeneration(shard, generation);
+    if (shard.key_to_entry.count(key) == 0) {
+        shard.entries.emplace_front(std::move(key), documents);
+        shard.key_to_entry.emplace(shard.entries.front().first, shard.entries.begin());
+        if (shard.entries.size() > shard_capacity_) {
+            shard.key_to_entry.erase(shard.entries.back().first);
+            shard.entries.pop_back();
+        }
+    }
+    return documents;
+}
+
+std::vector<Document> CachedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t max_count) {
+    return FindTopDocuments(raw_query, DocumentFilter{status, std::nullopt, std::nullopt}, max_count);
+}
+
+std::vector<Document> CachedSearchServer::FindTopDocuments(std::string_view raw_query) {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+CacheStats CachedSearchServer::GetStats() const {
+    return {hit_count_.load(), miss_count_.load()};
+}
+
+std::string CachedSearchServer::MakeKey(const SearchServer::Query& query, const DocumentFilter& filter, size_t max_count) {
+    std::string key;
+    key.reserve((query.plus_terms.size() + query.minus_terms.size()) * sizeof(InvertedIndex::TermId) + 64);
+    AppendBytes(key, query.plus_terms.size());
+    for (const InvertedIndex::TermId term_id : query.plus_terms) {
+        AppendBytes(key, term_id);
+    }
+    AppendBytes(key, query.minus_terms.size());
+    for (const InvertedIndex::TermId term_id : query.minus_terms) {
+        AppendBytes(key, term_id);
+    }
+    AppendBytes(key, query.phrases.size());
+    for (const auto& phrase : query.phrases) {
+        AppendBytes(key, phrase.term_ids.size());
+        for (size_t i = 0; i < phrase.term_ids.size(); ++i) {
+            AppendBytes(key, phrase.term_ids[i]);
+            AppendBytes(key, phrase.offsets[i]);
+        }
+        AppendBytes(key, phrase.max_distance);
+    }
+    // Незаданные поля фильтра кодируются флагом, а не значением
+    AppendBytes(key, filter.status.has_value());
+    AppendBytes(key, filter.status.value_or(DocumentStatus::ACTUAL));
+    AppendBytes(key, filter.min_rating.has_value());
+    AppendBytes(key, filter.min_rating.value_or(0));
+    AppendBytes(key, filter.max_rating.has_value());
+    AppendBytes(key, filter.max_rating.value_or(0));
+    AppendBytes(key, max_count);
+    return key;
+}
+
+void CachedSearchServer::SyncGeneration(Shard& shard, uint64_t generation) {
+    if (shard.generation != generation) {
+        shard.key_to_entry.clear();
+        shard.entries.clear();
+        shard.generation = generation;
+    }
+}
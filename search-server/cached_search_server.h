@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "search_server.h"
+
+struct CacheStats {
+    size_t hit_count;
+    size_t miss_count;
+};
+
+// Кэш результатов поиска поверх SearchServer с вытеснением давно не запрошенных (LRU).
+// Ключ — разобранный запрос (упорядоченные id плюс- и минус-слов), фильтр и число документов:
+// запросы, отличающиеся порядком слов, повторами или словами не из словаря, делят одну запись.
+// Любое изменение сервера меняет его поколение и сбрасывает весь кэш: IDF зависит от числа
+// документов, поэтому добавление документа меняет релевантность всех ответов.
+// Кэш разбит на независимые части со своими мьютексами, поиск в нём можно вести из нескольких потоков,
+// пока сервер не изменяется
+class CachedSearchServer {
+public:
+    static constexpr size_t DEFAULT_SHARD_COUNT = 16;
+
+    CachedSearchServer(const SearchServer& search_server, size_t capacity, size_t shard_count = DEFAULT_SHARD_COUNT);
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT);
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT);
+    std::vector<Document> FindTopDocuments(std::string_view raw_query);
+
+    CacheStats GetStats() const;
+
+private:
+    struct Shard {
+        std::mutex mutex;
+        uint64_t generation = 0;
+        // От недавно запрошенных к давним
+        std::list<std::pair<std::string, std::vector<Document>>> entries;
+        std::unordered_map<std::string_view, decltype(entries)::iterator> key_to_entry;
+    };
+
+    const SearchServer& search_server_;
+    size_t shard_capacity_;
+    std::vector<Shard> shards_;
+    std::atomic<size_t> hit_count_{0};
+    std::atomic<size_t> miss_count_{0};
+
+    static std::string MakeKey(const SearchServer::Query& query, const DocumentFilter& filter, size_t max_count);
+    // Записи другого поколения сервера удаляются целиком
+    static void SyncGeneration(Shard& shard, uint64_t generation);
+};
@@ -0,0 +1,79 @@
+#include "concurrent_search_server.h"
+
+#include <algorithm>
+#include <atomic>
+
+ConcurrentSearchServer::ConcurrentSearchServer(SearchServer search_server)
+        : index_(std::move(search_server))
+{
+    index_.Flush();
+    snapshot_ = std::make_shared<const SegmentedSearchServer>(index_);
+}
+
+std::shared_ptr<const SegmentedSearchServer> ConcurrentSearchServer::GetSnapshot() const {
+    return std::atomic_load(&snapshot_);
+}
+
+std::tuple<std::vector<std::string>, DocumentStatus> ConcurrentSearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+    const auto snapshot = GetSnapshot();
+    const auto [words, status] = snapshot->MatchDocument(raw_query, document_id);
+    return {std::vector<std::string>(words.begin(), words.end()), status};
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+    return GetSnapshot()->GetDocumentCount();
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    std::lock_guard guard(writer_mutex_);
+    pending_changes_.push_back({false, document_id, std::string(document), status, ratings});
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    std::lock_guard guard(writer_mutex_);
+    pending_changes_.push_back({true, document_id, {}, DocumentStatus::ACTUAL, {}});
+}
+
+void ConcurrentSearchServer::Publish() {
+    std::lock_guard guard(writer_mutex_);
+    ReleaseRetiredSnapshots();
+    if (pending_changes_.empty()) {
+        return;
+    }
+    const std::vector<PendingChange> changes = std::move(pending_changes_);
+    pending_changes_.clear();
+
+    // Снимок меняет только писатель, поэтому его можно читать без atomic_load.
+    // Индекс писателя совпадает с ним, так что при ошибке индекс восстанавливается из снимка
+    try {
+        ApplyChanges(index_, changes);
+    } catch (...) {
+        index_ = SegmentedSearchServer(*snapshot_);
+        throw;
+    }
+    index_.Flush();
+    auto next_snapshot = std::make_shared<const SegmentedSearchServer>(index_);
+    retired_snapshots_.push_back(std::atomic_exchange(&snapshot_, std::move(next_snapshot)));
+}
+
+void ConcurrentSearchServer::ApplyChanges(SegmentedSearchServer& index, const std::vector<PendingChange>& changes) {
+    for (const PendingChange& change : changes) {
+        if (change.is_removal) {
+            index.RemoveDocument(change.document_id);
+        } else {
+            index.AddDocument(change.document_id, change.text, change.status, change.ratings);
+        }
+    }
+}
+
+// Заменённый снимок недоступен через snapshot_, поэтому, когда ссылка писателя осталась единственной,
+// новых ссылок уже не появится. Барьер упорядочивает освобождение после чтений снимка, сделанных читателями
+void ConcurrentSearchServer::ReleaseRetiredSnapshots() {
+    retired_snapshots_.erase(std::remove_if(retired_snapshots_.begin(), retired_snapshots_.end(), [](const auto& snapshot) {
+        if (snapshot.use_count() > 1) {
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }), retired_snapshots_.end());
+}
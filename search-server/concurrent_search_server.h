@@ -0,0 +1,63 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "search_server.h"
+#include "segmented_search_server.h"
+
+// Поиск из многих потоков при одном писателе. Читатели работают с неизменяемым снимком индекса
+// и никогда не ждут писателя. Писатель накапливает изменения, применяет их к своему сегментированному
+// индексу и атомарно публикует его копию. Копия делит с индексом писателя неизменяемые сегменты,
+// поэтому публикация копирует лишь отметки удалённых документов, а не весь индекс.
+// Заменённые снимки освобождает писатель, когда их отпустят все читатели, а не последний из читателей
+class ConcurrentSearchServer {
+public:
+    explicit ConcurrentSearchServer(SearchServer search_server);
+
+    std::shared_ptr<const SegmentedSearchServer> GetSnapshot() const;
+
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(Args&&... args) const;
+    // Слова копируются: снимок, в который указывали бы string_view, может быть освобождён после возврата.
+    // Чтобы обойтись без копий, держите снимок из GetSnapshot и вызывайте MatchDocument у него
+    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+    int GetDocumentCount() const;
+
+    // Изменения становятся видны читателям только после Publish
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+    // Заодно освобождает заменённые снимки, которые отпустили читатели. При ошибке в любом изменении
+    // опубликованный снимок не меняется, а накопленные изменения отбрасываются
+    void Publish();
+
+private:
+    struct PendingChange {
+        bool is_removal;
+        int document_id;
+        std::string text;
+        DocumentStatus status;
+        std::vector<int> ratings;
+    };
+
+    std::shared_ptr<const SegmentedSearchServer> snapshot_;
+    std::mutex writer_mutex_;
+    std::vector<PendingChange> pending_changes_;
+    // Индекс писателя; после каждой публикации совпадает со снимком
+    SegmentedSearchServer index_;
+    // Снимки, заменённые новыми, которые ещё могут держать читатели
+    std::vector<std::shared_ptr<const SegmentedSearchServer>> retired_snapshots_;
+
+    static void ApplyChanges(SegmentedSearchServer& index, const std::vector<PendingChange>& changes);
+    void ReleaseRetiredSnapshots();
+};
+
+template <typename... Args>
+std::vector<Document> ConcurrentSearchServer::FindTopDocuments(Args&&... args) const {
+    return GetSnapshot()->FindTopDocuments(std::forward<Args>(args)...);
+}
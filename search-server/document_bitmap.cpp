@@ -0,0 +1,263 @@
+#include "document_bitmap.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+uint16_t GetKey(int document_id) {
+    return static_cast<uint16_t>(static_cast<uint32_t>(document_id) >> 16);
+}
+
+uint16_t GetLowBits(int document_id) {
+    return static_cast<uint16_t>(static_cast<uint32_t>(document_id) & 0xFFFF);
+}
+
+} // namespace
+
+bool DocumentBitmap::Container::IsDense() const {
+    return !bits.empty();
+}
+
+bool DocumentBitmap::Container::Add(uint16_t value) {
+    if (IsDense()) {
+        uint64_t& word = bits[value / 64];
+        const uint64_t mask = uint64_t{1} << (value % 64);
+        if ((word & mask) != 0) {
+            return false;
+        }
+        word |= mask;
+        ++size;
+        return true;
+    }
+    const auto it = std::lower_bound(values.begin(), values.end(), value);
+    if (it != values.end() && *it == value) {
+        return false;
+    }
+    values.insert(it, value);
+    ++size;
+    if (size > MAX_SPARSE_SIZE) {
+        MakeDense();
+    }
+    return true;
+}
+
+bool DocumentBitmap::Container::Remove(uint16_t value) {
+    if (IsDense()) {
+        uint64_t& word = bits[value / 64];
+        const uint64_t mask = uint64_t{1} << (value % 64);
+        if ((word & mask) == 0) {
+            return false;
+        }
+        word &= ~mask;
+        --size;
+        if (size < MIN_DENSE_SIZE) {
+            MakeSparse();
+        }
+        return true;
+    }
+    const auto it = std::lower_bound(values.begin(), values.end(), value);
+    if (it == values.end() || *it != value) {
+        return false;
+    }
+    values.erase(it);
+    --size;
+    return true;
+}
+
+bool DocumentBitmap::Container::Contains(uint16_t value) const {
+    if (IsDense()) {
+        return (bits[value / 64] >> (value % 64) & 1) != 0;
+    }
+    return std::binary_search(values.begin(), values.end(), value);
+}
+
+void DocumentBitmap::Container::MakeDense() {
+    bits.assign(DENSE_WORD_COUNT, 0);
+    for (const uint16_t value : values) {
+        bits[value / 64] |= uint64_t{1} << (value % 64);
+    }
+    values.clear();
+    values.shrink_to_fit();
+}
+
+void DocumentBitmap::Container::MakeSparse() {
+    values.clear();
+    values.reserve(size);
+    for (size_t i = 0; i < bits.size(); ++i) {
+        for (uint64_t word = bits[i]; word != 0; word &= word - 1) {
+            values.push_back(static_cast<uint16_t>(i * 64 + __builtin_ctzll(word)));
+        }
+    }
+    bits.clear();
+    bits.shrink_to_fit();
+}
+
+void DocumentBitmap::Container::Unite(const Container& other) {
+    if (!IsDense() && !other.IsDense()) {
+        std::vector<uint16_t> merged;
+        merged.reserve(values.size() + other.values.size());
+        std::set_union(values.begin(), values.end(), other.values.begin(), other.values.end(), std::back_inserter(merged));
+        values.swap(merged);
+        size = values.size();
+        if (size > MAX_SPARSE_SIZE) {
+            MakeDense();
+        }
+        return;
+    }
+    if (!IsDense()) {
+        MakeDense();
+    }
+    if (other.IsDense()) {
+        for (size_t i = 0; i < DENSE_WORD_COUNT; ++i) {
+            bits[i] |= other.bits[i];
+        }
+    } else {
+        for (const uint16_t value : other.values) {
+            bits[value / 64] |= uint64_t{1} << (value % 64);
+        }
+    }
+    size = 0;
+    for (const uint64_t word : bits) {
+        size += __builtin_popcountll(word);
+    }
+}
+
+void DocumentBitmap::Container::Intersect(const Container& other) {
+    if (IsDense() && other.IsDense()) {
+        size = 0;
+        for (size_t i = 0; i < DENSE_WORD_COUNT; ++i) {
+            bits[i] &= other.bits[i];
+            size += __builtin_popcountll(bits[i]);
+        }
+        if (size < MIN_DENSE_SIZE) {
+            MakeSparse();
+        }
+        return;
+    }
+    if (IsDense()) {
+        std::vector<uint16_t> common;
+        std::copy_if(other.values.begin(), other.values.end(), std::back_inserter(common), [this](uint16_t value) {
+            return Contains(value);
+        });
+        bits.clear();
+        bits.shrink_to_fit();
+        values.swap(common);
+    } else {
+        values.erase(std::remove_if(values.begin(), values.end(), [&other](uint16_t value) {
+            return !other.Contains(value);
+        }), values.end());
+    }
+    size = values.size();
+}
+
+bool DocumentBitmap::Add(int document_id) {
+    const uint16_t key = GetKey(document_id);
+    auto it = FindContainer(key);
+    if (it == containers_.end() || it->key != key) {
+        it = containers_.insert(it, Container{key, 0, {}, {}});
+    }
+    return it->Add(GetLowBits(document_id));
+}
+
+bool DocumentBitmap::Remove(int document_id) {
+    const uint16_t key = GetKey(document_id);
+    const auto it = FindContainer(key);
+    if (it == containers_.end() || it->key != key || !it->Remove(GetLowBits(document_id))) {
+        return false;
+    }
+    if (it->size == 0) {
+        containers_.erase(it);
+    }
+    return true;
+}
+
+bool DocumentBitmap::Contains(int document_id) const {
+    const uint16_t key = GetKey(document_id);
+    const auto it = FindContainer(key);
+    return it != containers_.end() && it->key == key && it->Contains(GetLowBits(document_id));
+}
+
+size_t DocumentBitmap::GetSize() const {
+    size_t size = 0;
+    for (const Container& container : containers_) {
+        size += container.size;
+    }
+    return size;
+}
+
+bool DocumentBitmap::IsEmpty() const {
+    return containers_.empty();
+}
+
+std::vector<int> DocumentBitmap::ToVector() const {
+    std::vector<int> document_ids;
+    document_ids.reserve(GetSize());
+    for (const Container& container : containers_) {
+        const uint32_t high_bits = static_cast<uint32_t>(container.key) << 16;
+        if (container.IsDense()) {
+            for (size_t i = 0; i < container.bits.size(); ++i) {
+                for (uint64_t word = container.bits[i]; word != 0; word &= word - 1) {
+                    document_ids.push_back(static_cast<int>(high_bits | (i * 64 + __builtin_ctzll(word))));
+                }
+            }
+        } else {
+            for (const uint16_t value : container.values) {
+                document_ids.push_back(static_cast<int>(high_bits | value));
+            }
+        }
+    }
+    return document_ids;
+}
+
+DocumentBitmap& DocumentBitmap::operator|=(const DocumentBitmap& other) {
+    std::vector<Container> merged;
+    merged.reserve(containers_.size() + other.containers_.size());
+    auto it = containers_.begin();
+    auto other_it = other.containers_.begin();
+    while (it != containers_.end() || other_it != other.containers_.end()) {
+        if (other_it == other.containers_.end() || (it != containers_.end() && it->key < other_it->key)) {
+            merged.push_back(std::move(*it++));
+        } else if (it == containers_.end() || other_it->key < it->key) {
+            merged.push_back(*other_it++);
+        } else {
+            it->Unite(*other_it++);
+            merged.push_back(std::move(*it++));
+        }
+    }
+    containers_.swap(merged);
+    return *this;
+}
+
+DocumentBitmap& DocumentBitmap::operator&=(const DocumentBitmap& other) {
+    std::vector<Container> common;
+    auto other_it = other.containers_.begin();
+    for (Container& container : containers_) {
+        while (other_it != other.containers_.end() && other_it->key < container.key) {
+            ++other_it;
+        }
+        if (other_it == other.containers_.end()) {
+            break;
+        }
+        if (other_it->key == container.key) {
+            container.Intersect(*other_it);
+            if (container.size > 0) {
+                common.push_back(std::move(container));
+            }
+        }
+    }
+    containers_.swap(common);
+    return *this;
+}
+
+std::vector<DocumentBitmap::Container>::iterator DocumentBitmap::FindContainer(uint16_t key) {
+    return std::lower_bound(containers_.begin(), containers_.end(), key, [](const Container& container, uint16_t value) {
+        return container.key < value;
+    });
+}
+
+std::vector<DocumentBitmap::Container>::const_iterator DocumentBitmap::FindContainer(uint16_t key) const {
+    return std::lower_bound(containers_.begin(), containers_.end(), key, [](const Container& container, uint16_t value) {
+        return container.key < value;
+    });
+}
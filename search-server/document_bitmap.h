@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Множество id документов в духе Roaring: id делятся по старшим 16 битам на контейнеры.
+// Разреженный контейнер хранит отсортированный массив младших половин id,
+// плотный — битовую карту на 65536 значений
+class DocumentBitmap {
+public:
+    // Вставка и удаление возвращают, изменилось ли множество
+    bool Add(int document_id);
+    bool Remove(int document_id);
+    bool Contains(int document_id) const;
+
+    size_t GetSize() const;
+    bool IsEmpty() const;
+    std::vector<int> ToVector() const;
+
+    DocumentBitmap& operator|=(const DocumentBitmap& other);
+    DocumentBitmap& operator&=(const DocumentBitmap& other);
+
+private:
+    // Плотный контейнер становится разреженным только ниже MIN_DENSE_SIZE, чтобы добавления и удаления
+    // около границы не перестраивали его каждый раз
+    static constexpr size_t MAX_SPARSE_SIZE = 4096;
+    static constexpr size_t MIN_DENSE_SIZE = 2048;
+    static constexpr size_t DENSE_WORD_COUNT = 65536 / 64;
+
+    struct Container {
+        uint16_t key;
+        size_t size = 0;
+        std::vector<uint16_t> values;
+        std::vector<uint64_t> bits;
+
+        bool IsDense() const;
+        bool Add(uint16_t value);
+        bool Remove(uint16_t value);
+        bool Contains(uint16_t value) const;
+        void MakeDense();
+        void MakeSparse();
+        void Unite(const Container& other);
+        void Intersect(const Container& other);
+    };
+
+    // Упорядочены по key, пустых контейнеров нет
+    std::vector<Container> containers_;
+
+    std::vector<Container>::iterator FindContainer(uint16_t key);
+    std::vector<Container>::const_iterator FindContainer(uint16_t key) const;
+};
@@ -0,0 +1,27 @@
+#include "document_signature.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// splitmix64 с разной затравкой для каждой хеш-функции
+uint32_t HashTerm(InvertedIndex::TermId term_id, size_t hash_index) {
+    uint64_t x = term_id + 0x9E3779B97F4A7C15ull * (hash_index + 1);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return static_cast<uint32_t>(x ^ (x >> 31));
+}
+
+} // namespace
+
+DocumentSignature ComputeDocumentSignature(const std::vector<std::pair<InvertedIndex::TermId, double>>& term_freqs) {
+    DocumentSignature signature;
+    signature.fill(std::numeric_limits<uint32_t>::max());
+    for (const auto& [term_id, term_freq] : term_freqs) {
+        for (size_t i = 0; i < SIGNATURE_SIZE; ++i) {
+            signature[i] = std::min(signature[i], HashTerm(term_id, i));
+        }
+    }
+    return signature;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "inverted_index.h"
+
+constexpr size_t SIGNATURE_SIZE = 16;
+
+// MinHash-сигнатура набора термов документа: для каждой из SIGNATURE_SIZE хеш-функций — минимум по термам.
+// Доля совпавших позиций двух сигнатур оценивает коэффициент Жаккара наборов
+using DocumentSignature = std::array<uint32_t, SIGNATURE_SIZE>;
+
+DocumentSignature ComputeDocumentSignature(const std::vector<std::pair<InvertedIndex::TermId, double>>& term_freqs);
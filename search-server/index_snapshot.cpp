@@ -0,0 +1,398 @@
+#include "index_snapshot.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = {'S', 'R', 'C', 'H', 'I', 'D', 'X', '\0'};
+
+template <typename T>
+void AppendBytes(std::vector<char>& buffer, const T& value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+void AlignBuffer(std::vector<char>& buffer) {
+    buffer.resize((buffer.size() + 7) / 8 * 8, '\0');
+}
+
+// count записей по entry_size байт со смещения offset помещаются в файл размера file_size
+bool IsSectionInFile(uint64_t offset, uint64_t count, size_t entry_size, uint64_t file_size) {
+    return offset % 8 == 0 && offset <= file_size && count <= (file_size - offset) / entry_size;
+}
+
+// Записывает файл и дожидается, пока данные дойдут до диска
+bool WriteFileSynced(const std::string& path, const std::vector<char>& data) {
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    size_t written = 0;
+    while (written < data.size()) {
+        const ssize_t result = write(fd, data.data() + written, data.size() - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            close(fd);
+            return false;
+        }
+        written += result;
+    }
+    const bool is_synced = fsync(fd) == 0;
+    return close(fd) == 0 && is_synced;
+}
+
+// Без этого переименование может не пережить сбой, даже если данные файла уже на диске
+bool SyncParentDirectory(const std::string& path) {
+    const std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    const int fd = open(parent.empty() ? "." : parent.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return false;
+    }
+    const bool is_synced = fsync(fd) == 0;
+    return close(fd) == 0 && is_synced;
+}
+
+// FNV-1a, 64 бита
+uint64_t UpdateChecksum(uint64_t hash, const char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+} // namespace
+
+void IndexSnapshot::Save(const SearchServer& search_server, const std::string& path) {
+    const InvertedIndex& index = search_server.word_to_document_freqs_;
+
+    std::vector<InvertedIndex::TermId> term_ids;
+    for (InvertedIndex::TermId term_id = 0; term_id < index.GetTermCount(); ++term_id) {
+        if (index.GetDocumentFreq(term_id) > 0) {
+            term_ids.push_back(term_id);
+        }
+    }
+    std::sort(term_ids.begin(), term_ids.end(), [&index](InvertedIndex::TermId lhs, InvertedIndex::TermId rhs) {
+        return index.GetTerm(lhs) < index.GetTerm(rhs);
+    });
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.document_count = search_server.GetDocumentCount();
+    header.term_count = term_ids.size();
+    header.stop_word_count = search_server.stop_words_.size();
+
+    std::vector<char> buffer(sizeof(Header), '\0');
+    std::vector<char> strings;
+
+    header.documents_offset = buffer.size();
+    const auto& documents = search_server.documents_;
+    std::vector<int> slot_to_document_index(documents.ids.size());
+    for (const int document_id : search_server.document_ids_) {
+        const int slot = search_server.document_slots_.at(document_id);
+        slot_to_document_index[slot] = static_cast<int>((buffer.size() - header.documents_offset) / sizeof(DocumentEntry));
+        AppendBytes(buffer, DocumentEntry{document_id, documents.ratings[slot], static_cast<int32_t>(documents.statuses[slot]), 0});
+    }
+
+    AlignBuffer(buffer);
+    header.terms_offset = buffer.size();
+    uint64_t posting_count = 0;
+    for (const InvertedIndex::TermId term_id : term_ids) {
+        const std::string_view term = index.GetTerm(term_id);
+        const TermEntry entry{{strings.size(), term.size()}, posting_count, index.GetDocumentFreq(term_id)};
+        strings.insert(strings.end(), term.begin(), term.end());
+        posting_count += entry.posting_count;
+        AppendBytes(buffer, entry);
+    }
+    header.posting_count = posting_count;
+
+    // Сервер хранит во вхождениях слоты, снимок — номера документов по возрастанию id, поэтому списки
+    // пересортировываются. Тот же IDF и то же произведение, что в SearchServer, чтобы релевантности совпадали до бита
+    AlignBuffer(buffer);
+    header.postings_offset = buffer.size();
+    std::vector<char> impacts;
+    std::vector<Posting> term_postings;
+    const double log_document_count = log(search_server.GetDocumentCount());
+    for (const InvertedIndex::TermId term_id : term_ids) {
+        term_postings.clear();
+        for (auto cursor = index.GetCursor(term_id); !cursor.IsEnd(); cursor.Next()) {
+            term_postings.push_back({slot_to_document_index[cursor->document_id], cursor->term_freq});
+        }
+        std::sort(term_postings.begin(), term_postings.end(), [](const Posting& lhs, const Posting& rhs) {
+            return lhs.document_id < rhs.document_id;
+        });
+        const double inverse_document_freq = search_server.ComputeWordInverseDocumentFreq(term_id, log_document_count);
+        for (const Posting& term_posting : term_postings) {
+            Posting posting;
+            std::memset(&posting, 0, sizeof(posting));
+            posting.document_id = term_posting.document_id;
+            posting.term_freq = term_posting.term_freq;
+            AppendBytes(buffer, posting);
+            AppendBytes(impacts, term_posting.term_freq * inverse_document_freq);
+        }
+    }
+    header.impacts_offset = buffer.size();
+    buffer.insert(buffer.end(), impacts.begin(), impacts.end());
+
+    AlignBuffer(buffer);
+    header.stop_words_offset = buffer.size();
+    for (const std::string& stop_word : search_server.stop_words_) {
+        AppendBytes(buffer, StringEntry{strings.size(), stop_word.size()});
+        strings.insert(strings.end(), stop_word.begin(), stop_word.end());
+    }
+
+    AlignBuffer(buffer);
+    header.strings_offset = buffer.size();
+    buffer.insert(buffer.end(), strings.begin(), strings.end());
+    header.file_size = buffer.size();
+
+    header.checksum = ComputeChecksum(header, buffer.data() + sizeof(Header), buffer.size() - sizeof(Header));
+    std::memcpy(buffer.data(), &header, sizeof(header));
+
+    const std::string temporary_path = path + ".tmp";
+    if (!WriteFileSynced(temporary_path, buffer) || std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        std::remove(temporary_path.c_str());
+        throw std::runtime_error("Не удалось записать снимок индекса: " + path);
+    }
+    if (!SyncParentDirectory(path)) {
+        throw std::runtime_error("Не удалось сохранить на диск каталог снимка индекса: " + path);
+    }
+}
+
+IndexSnapshot::IndexSnapshot(const std::string& path, bool verify_checksum) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Не удалось открыть снимок индекса: " + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(Header)) {
+        close(fd);
+        throw std::runtime_error("Повреждён снимок индекса: " + path);
+    }
+    mapping_size_ = file_stat.st_size;
+    mapping_ = mmap(nullptr, mapping_size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping_ == MAP_FAILED) {
+        mapping_ = nullptr;
+        throw std::runtime_error("Не удалось отобразить снимок индекса: " + path);
+    }
+
+    const char* data = static_cast<const char*>(mapping_);
+    header_ = reinterpret_cast<const Header*>(data);
+    if (std::memcmp(header_->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0
+        || header_->version != VERSION
+        || header_->file_size != mapping_size_
+        || (verify_checksum && header_->checksum != ComputeChecksum(*header_, data + sizeof(Header), mapping_size_ - sizeof(Header)))
+        || !MapSections()) {
+        Unmap();
+        throw std::runtime_error("Повреждён снимок индекса или неподдерживаемая версия: " + path);
+    }
+}
+
+IndexSnapshot::~IndexSnapshot() {
+    Unmap();
+}
+
+IndexSnapshot::IndexSnapshot(IndexSnapshot&& other) noexcept {
+    *this = std::move(other);
+}
+
+IndexSnapshot& IndexSnapshot::operator=(IndexSnapshot&& other) noexcept {
+    if (this != &other) {
+        Unmap();
+        mapping_ = std::exchange(other.mapping_, nullptr);
+        mapping_size_ = std::exchange(other.mapping_size_, 0);
+        header_ = std::exchange(other.header_, nullptr);
+        documents_ = other.documents_;
+        terms_ = other.terms_;
+        postings_ = other.postings_;
+        impacts_ = other.impacts_;
+        stop_words_ = other.stop_words_;
+        strings_ = other.strings_;
+    }
+    return *this;
+}
+
+std::vector<Document> IndexSnapshot::FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t max_count) const {
+    return FindTopDocuments(raw_query, [status](int, DocumentStatus document_status, int) {return document_status == status;}, max_count);
+}
+
+std::vector<Document> IndexSnapshot::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> IndexSnapshot::MatchDocument(std::string_view raw_query, int document_id) const {
+    const DocumentEntry* document = FindDocument(document_id);
+    if (document == nullptr) {
+        throw std::invalid_argument("Документ не найден");
+    }
+    const auto status = static_cast<DocumentStatus>(document->status);
+    const int document_index = static_cast<int>(document - documents_);
+    const Query query = ParseQuery(raw_query);
+
+    for (std::string_view word : query.minus_words) {
+        const TermEntry* term = FindTerm(word);
+        if (term != nullptr && HasPosting(*term, document_index)) {
+            return {std::vector<std::string_view>{}, status};
+        }
+    }
+    std::vector<std::string_view> matched_words;
+    for (std::string_view word : query.plus_words) {
+        const TermEntry* term = FindTerm(word);
+        if (term != nullptr && HasPosting(*term, document_index)) {
+            matched_words.push_back(word);
+        }
+    }
+    return {matched_words, status};
+}
+
+int IndexSnapshot::GetDocumentCount() const {
+    return static_cast<int>(header_->document_count);
+}
+
+uint64_t IndexSnapshot::ComputeChecksum(Header header, const char* data, size_t size) {
+    header.checksum = 0;
+    const uint64_t hash = UpdateChecksum(14695981039346656037ull, reinterpret_cast<const char*>(&header), sizeof(header));
+    return UpdateChecksum(hash, data, size);
+}
+
+// Указатели на секции заводятся, только когда секции помещаются в файл; записи о термах, вхождения
+// и стоп-слова проверяются по ним, чтобы поиск не вышел за файл и без проверки контрольной суммы
+bool IndexSnapshot::MapSections() {
+    const Header& header = *header_;
+    if (!IsSectionInFile(header.documents_offset, header.document_count, sizeof(DocumentEntry), mapping_size_)
+        || !IsSectionInFile(header.terms_offset, header.term_count, sizeof(TermEntry), mapping_size_)
+        || !IsSectionInFile(header.postings_offset, header.posting_count, sizeof(Posting), mapping_size_)
+        || !IsSectionInFile(header.impacts_offset, header.posting_count, sizeof(double), mapping_size_)
+        || !IsSectionInFile(header.stop_words_offset, header.stop_word_count, sizeof(StringEntry), mapping_size_)
+        || !IsSectionInFile(header.strings_offset, 0, 1, mapping_size_)) {
+        return false;
+    }
+    const char* data = static_cast<const char*>(mapping_);
+    documents_ = reinterpret_cast<const DocumentEntry*>(data + header.documents_offset);
+    terms_ = reinterpret_cast<const TermEntry*>(data + header.terms_offset);
+    postings_ = reinterpret_cast<const Posting*>(data + header.postings_offset);
+    impacts_ = reinterpret_cast<const double*>(data + header.impacts_offset);
+    stop_words_ = reinterpret_cast<const StringEntry*>(data + header.stop_words_offset);
+    strings_ = data + header.strings_offset;
+
+    const uint64_t strings_size = mapping_size_ - header.strings_offset;
+    const auto is_string_in_file = [strings_size](const StringEntry& entry) {
+        return entry.offset <= strings_size && entry.length <= strings_size - entry.offset;
+    };
+    return std::all_of(terms_, terms_ + header.term_count, [&](const TermEntry& term) {
+               return is_string_in_file(term.text) && term.first_posting <= header.posting_count
+                   && term.posting_count <= header.posting_count - term.first_posting;
+           })
+        && std::all_of(postings_, postings_ + header.posting_count, [&header](const Posting& posting) {
+               return posting.document_id >= 0 && static_cast<uint64_t>(posting.document_id) < header.document_count;
+           })
+        && std::all_of(stop_words_, stop_words_ + header.stop_word_count, is_string_in_file);
+}
+
+std::string_view IndexSnapshot::GetString(const StringEntry& entry) const {
+    return {strings_ + entry.offset, entry.length};
+}
+
+const IndexSnapshot::DocumentEntry* IndexSnapshot::FindDocument(int document_id) const {
+    const DocumentEntry* end = documents_ + header_->document_count;
+    const DocumentEntry* it = std::lower_bound(documents_, end, document_id, [](const DocumentEntry& document, int id) {
+        return document.id < id;
+    });
+    return it != end && it->id == document_id ? it : nullptr;
+}
+
+const IndexSnapshot::TermEntry* IndexSnapshot::FindTerm(std::string_view word) const {
+    const TermEntry* end = terms_ + header_->term_count;
+    const TermEntry* it = std::lower_bound(terms_, end, word, [this](const TermEntry& term, std::string_view value) {
+        return GetString(term.text) < value;
+    });
+    return it != end && GetString(it->text) == word ? it : nullptr;
+}
+
+bool IndexSnapshot::HasPosting(const TermEntry& term, int document_index) const {
+    const Posting* begin = postings_ + term.first_posting;
+    const Posting* end = begin + term.posting_count;
+    const Posting* it = std::lower_bound(begin, end, document_index, [](const Posting& posting, int index) {
+        return posting.document_id < index;
+    });
+    return it != end && it->document_id == document_index;
+}
+
+std::vector<int> IndexSnapshot::CollectDocuments(const std::vector<std::string_view>& words) const {
+    std::vector<int> document_indexes;
+    std::vector<int> term_document_indexes;
+    std::vector<int> buffer;
+    for (std::string_view word : words) {
+        const TermEntry* term = FindTerm(word);
+        if (term == nullptr) {
+            continue;
+        }
+        const Posting* postings = postings_ + term->first_posting;
+        term_document_indexes.clear();
+        for (const Posting* posting = postings; posting != postings + term->posting_count; ++posting) {
+            term_document_indexes.push_back(posting->document_id);
+        }
+        buffer.clear();
+        std::set_union(document_indexes.begin(), document_indexes.end(),
+                       term_document_indexes.begin(), term_document_indexes.end(),
+                       std::back_inserter(buffer));
+        document_indexes.swap(buffer);
+    }
+    return document_indexes;
+}
+
+bool IndexSnapshot::IsStopWord(std::string_view word) const {
+    const StringEntry* end = stop_words_ + header_->stop_word_count;
+    const StringEntry* it = std::lower_bound(stop_words_, end, word, [this](const StringEntry& entry, std::string_view value) {
+        return GetString(entry) < value;
+    });
+    return it != end && GetString(*it) == word;
+}
+
+IndexSnapshot::Query IndexSnapshot::ParseQuery(std::string_view text) const {
+    Query query;
+    std::vector<std::string_view> words;
+    if (const auto invalid_word = SplitIntoWords(text, words)) {
+        throw std::invalid_argument("Некорректный ввод: " + std::string(*invalid_word));
+    }
+    for (std::string_view word : words) {
+        const bool is_minus = word[0] == '-';
+        if (is_minus) {
+            word.remove_prefix(1);
+        }
+        if (word.empty() || word[0] == '-') {
+            throw std::invalid_argument("Некорректный ввод: " + std::string(word));
+        }
+        if (!IsStopWord(word)) {
+            (is_minus ? query.minus_words : query.plus_words).push_back(word);
+        }
+    }
+    for (auto* words : {&query.plus_words, &query.minus_words}) {
+        std::sort(words->begin(), words->end());
+        words->erase(std::unique(words->begin(), words->end()), words->end());
+    }
+    return query;
+}
+
+void IndexSnapshot::Unmap() {
+    if (mapping_ != nullptr) {
+        munmap(mapping_, mapping_size_);
+        mapping_ = nullptr;
+        mapping_size_ = 0;
+    }
+}
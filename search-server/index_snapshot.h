@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+#include "posting_list.h"
+#include "search_server.h"
+
+// Снимок индекса SearchServer в версионированном бинарном файле. Открытый снимок отображается
+// в память только для чтения и отвечает на запросы сразу, без разбора в контейнеры SearchServer.
+// Снимок не меняется, поэтому вклад tf * idf каждого вхождения считается при сохранении,
+// и оценка запроса сводится к сложению подряд лежащих чисел. Вхождения ссылаются на номер документа
+// в секции документов, упорядоченной по id, так что данные документа читаются без поиска
+class IndexSnapshot {
+public:
+    // 2: добавлены вклады вхождений; 3: контрольная сумма покрывает и заголовок;
+    // 4: вхождения хранят номер документа вместо id
+    static constexpr uint32_t VERSION = 4;
+
+    // Пишет снимок во временный файл рядом с path, сбрасывает его на диск и переименовывает, затем
+    // сбрасывает каталог. Даже после сбоя по пути path лежит либо прежний, либо полностью записанный новый снимок
+    static void Save(const SearchServer& search_server, const std::string& path);
+
+    // Границы секций и записей о термах проверяются всегда, контрольная сумма — по verify_checksum
+    explicit IndexSnapshot(const std::string& path, bool verify_checksum = true);
+    ~IndexSnapshot();
+
+    IndexSnapshot(IndexSnapshot&& other) noexcept;
+    IndexSnapshot& operator=(IndexSnapshot&& other) noexcept;
+    IndexSnapshot(const IndexSnapshot&) = delete;
+    IndexSnapshot& operator=(const IndexSnapshot&) = delete;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+    int GetDocumentCount() const;
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+        uint64_t checksum;
+        uint64_t document_count;
+        uint64_t term_count;
+        uint64_t posting_count;
+        uint64_t stop_word_count;
+        uint64_t documents_offset;
+        uint64_t terms_offset;
+        uint64_t postings_offset;
+        uint64_t impacts_offset;
+        uint64_t stop_words_offset;
+        uint64_t strings_offset;
+        uint64_t file_size;
+    };
+
+    struct DocumentEntry {
+        int32_t id;
+        int32_t rating;
+        int32_t status;
+        int32_t reserved;
+    };
+
+    struct StringEntry {
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    struct TermEntry {
+        StringEntry text;
+        uint64_t first_posting;
+        uint64_t posting_count;
+    };
+
+    struct Query {
+        std::vector<std::string_view> plus_words;
+        std::vector<std::string_view> minus_words;
+    };
+
+    void* mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+    const Header* header_ = nullptr;
+    const DocumentEntry* documents_ = nullptr;
+    const TermEntry* terms_ = nullptr;
+    // В поле document_id — номер документа в documents_
+    const Posting* postings_ = nullptr;
+    // Вклад tf * idf, параллельно postings_
+    const double* impacts_ = nullptr;
+    const StringEntry* stop_words_ = nullptr;
+    const char* strings_ = nullptr;
+
+    // По заголовку с обнулённым полем checksum и size байтам данных после него
+    static uint64_t ComputeChecksum(Header header, const char* data, size_t size);
+    bool MapSections();
+
+    std::string_view GetString(const StringEntry& entry) const;
+    const DocumentEntry* FindDocument(int document_id) const;
+    const TermEntry* FindTerm(std::string_view word) const;
+    bool HasPosting(const TermEntry& term, int document_index) const;
+    // Номера документов со словами words по возрастанию
+    std::vector<int> CollectDocuments(const std::vector<std::string_view>& words) const;
+    bool IsStopWord(std::string_view word) const;
+    Query ParseQuery(std::string_view text) const;
+    void Unmap();
+};
+
+template <typename DocumentPredicate>
+std::vector<Document> IndexSnapshot::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                                      size_t max_count) const {
+    const Query query = ParseQuery(raw_query);
+    const std::vector<int> excluded_documents = CollectDocuments(query.minus_words);
+
+    // Вклады складываются в плотный накопитель по номеру документа в порядке плюс-слов, поэтому суммы те же, что при слиянии списков
+    SearchServer::RelevanceAccumulator& accumulator = SearchServer::GetThreadRelevanceAccumulator();
+    accumulator.Reserve(header_->document_count);
+    for (std::string_view word : query.plus_words) {
+        const TermEntry* term = FindTerm(word);
+        if (term == nullptr) {
+            continue;
+        }
+        auto excluded_it = excluded_documents.begin();
+        const Posting* postings = postings_ + term->first_posting;
+        const double* impact = impacts_ + term->first_posting;
+        for (const Posting* posting = postings; posting != postings + term->posting_count; ++posting, ++impact) {
+            const int document_index = posting->document_id;
+            const DocumentEntry& document = documents_[document_index];
+            if (SearchServer::ContainsDocument(excluded_documents, excluded_it, document_index)
+                || !document_predicate(document.id, static_cast<DocumentStatus>(document.status), document.rating)) {
+                continue;
+            }
+            accumulator.Add(document_index, *impact);
+        }
+    }
+    SearchServer::RelevanceList document_to_relevance;
+    accumulator.MoveTo(document_to_relevance);
+
+    std::vector<Document> top_documents;
+    for (const auto& [document_index, relevance] : document_to_relevance) {
+        const DocumentEntry& document = documents_[document_index];
+        SearchServer::PushTopDocument(top_documents, {document.id, relevance, document.rating}, max_count);
+    }
+    std::sort_heap(top_documents.begin(), top_documents.end(), SearchServer::IsMoreRelevant);
+    return top_documents;
+}
@@ -0,0 +1,342 @@
+#include "inverted_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <iterator>
+#include <numeric>
+
+namespace {
+
+auto FindPosting(std::vector<Posting>& postings, int document_id) {
+    return std::lower_bound(postings.begin(), postings.end(), document_id,
+                            [](const Posting& posting, int id) { return posting.document_id < id; });
+}
+
+auto FindPosting(const std::vector<Posting>& postings, int document_id) {
+    return std::lower_bound(postings.begin(), postings.end(), document_id,
+                            [](const Posting& posting, int id) { return posting.document_id < id; });
+}
+
+} // namespace
+
+InvertedIndex::InvertedIndex(const InvertedIndex& other)
+        : term_storage_(other.term_storage_)
+        , terms_(other.terms_)
+        , postings_(other.postings_)
+        , compressed_postings_(other.compressed_postings_)
+        , max_term_freqs_(other.max_term_freqs_)
+        , log_document_freqs_(other.log_document_freqs_)
+        , free_term_ids_(other.free_term_ids_)
+        , is_compressed_(other.is_compressed_)
+{
+    RebuildTermMap();
+}
+
+InvertedIndex& InvertedIndex::operator=(const InvertedIndex& other) {
+    if (this != &other) {
+        term_storage_ = other.term_storage_;
+        terms_ = other.terms_;
+        postings_ = other.postings_;
+        compressed_postings_ = other.compressed_postings_;
+        max_term_freqs_ = other.max_term_freqs_;
+        log_document_freqs_ = other.log_document_freqs_;
+        free_term_ids_ = other.free_term_ids_;
+        is_compressed_ = other.is_compressed_;
+        RebuildTermMap();
+    }
+    return *this;
+}
+
+InvertedIndex::TermId InvertedIndex::AddTerm(std::string_view word) {
+    if (const auto it = term_to_id_.find(word); it != term_to_id_.end()) {
+        return it->second;
+    }
+    if (!free_term_ids_.empty()) {
+        const TermId term_id = free_term_ids_.back();
+        free_term_ids_.pop_back();
+        terms_[term_id] = term_storage_.Add(word);
+        term_to_id_.emplace(GetTerm(term_id), term_id);
+        return term_id;
+    }
+    const TermId term_id = static_cast<TermId>(terms_.size());
+    terms_.push_back(term_storage_.Add(word));
+    term_to_id_.emplace(GetTerm(term_id), term_id);
+    postings_.emplace_back();
+    compressed_postings_.emplace_back();
+    max_term_freqs_.push_back(0.0);
+    log_document_freqs_.push_back(log(0.0));
+    return term_id;
+}
+
+std::optional<InvertedIndex::TermId> InvertedIndex::FindTerm(std::string_view word) const {
+    const auto it = term_to_id_.find(word);
+    if (it == term_to_id_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::string_view InvertedIndex::GetTerm(TermId term_id) const {
+    return term_storage_.Get(terms_[term_id]);
+}
+
+size_t InvertedIndex::GetTermCount() const {
+    return terms_.size();
+}
+
+void InvertedIndex::AddPosting(TermId term_id, int document_id, double term_freq) {
+    if (is_compressed_) {
+        CompressedPostingList& compressed = compressed_postings_[term_id];
+        if (compressed.IsEmpty() || compressed.GetLastDocumentId() < document_id) {
+            compressed.Append(document_id, term_freq);
+            max_term_freqs_[term_id] = std::max(max_term_freqs_[term_id], term_freq);
+            UpdateLogDocumentFreq(term_id);
+            return;
+        }
+        postings_[term_id] = compressed.Decompress();
+    }
+
+    auto& postings = postings_[term_id];
+    if (postings.empty() || postings.back().document_id < document_id) {
+        postings.push_back({document_id, term_freq});
+        max_term_freqs_[term_id] = std::max(max_term_freqs_[term_id], term_freq);
+    } else {
+        const auto it = FindPosting(postings, document_id);
+        if (it != postings.end() && it->document_id == document_id) {
+            it->term_freq += term_freq;
+            max_term_freqs_[term_id] = std::max(max_term_freqs_[term_id], it->term_freq);
+        } else {
+            postings.insert(it, {document_id, term_freq});
+            max_term_freqs_[term_id] = std::max(max_term_freqs_[term_id], term_freq);
+        }
+    }
+
+    if (is_compressed_) {
+        compressed_postings_[term_id] = CompressedPostingList(postings);
+        std::vector<Posting>().swap(postings);
+    }
+    UpdateLogDocumentFreq(term_id);
+}
+
+void InvertedIndex::AddPostings(TermId term_id, const std::vector<Posting>& new_postings) {
+    if (new_postings.empty()) {
+        return;
+    }
+    for (const Posting& posting : new_postings) {
+        max_term_freqs_[term_id] = std::max(max_term_freqs_[term_id], posting.term_freq);
+    }
+    if (is_compressed_) {
+        CompressedPostingList& compressed = compressed_postings_[term_id];
+        if (compressed.IsEmpty() || compressed.GetLastDocumentId() < new_postings.front().document_id) {
+            for (const Posting& posting : new_postings) {
+                compressed.Append(posting.document_id, posting.term_freq);
+            }
+            UpdateLogDocumentFreq(term_id);
+            return;
+        }
+        postings_[term_id] = compressed.Decompress();
+    }
+
+    auto& postings = postings_[term_id];
+    if (postings.empty() || postings.back().document_id < new_postings.front().document_id) {
+        postings.insert(postings.end(), new_postings.begin(), new_postings.end());
+    } else {
+        std::vector<Posting> merged;
+        merged.reserve(postings.size() + new_postings.size());
+        std::merge(postings.begin(), postings.end(), new_postings.begin(), new_postings.end(), std::back_inserter(merged),
+                   [](const Posting& lhs, const Posting& rhs) { return lhs.document_id < rhs.document_id; });
+        postings.swap(merged);
+    }
+
+    if (is_compressed_) {
+        compressed_postings_[term_id] = CompressedPostingList(postings);
+        std::vector<Posting>().swap(postings);
+    }
+    UpdateLogDocumentFreq(term_id);
+}
+
+void InvertedIndex::RemovePosting(TermId term_id, int document_id) {
+    if (is_compressed_) {
+        if (!compressed_postings_[term_id].Contains(document_id)) {
+            return;
+        }
+        postings_[term_id] = compressed_postings_[term_id].Decompress();
+    }
+
+    auto& postings = postings_[term_id];
+    const auto it = FindPosting(postings, document_id);
+    if (it == postings.end() || it->document_id != document_id) {
+        return;
+    }
+    const double term_freq = it->term_freq;
+    postings.erase(it);
+    if (term_freq >= max_term_freqs_[term_id]) {
+        UpdateMaxTermFreq(term_id, postings);
+    }
+    FinishRemoval(term_id);
+}
+
+void InvertedIndex::RemovePostings(TermId term_id, const std::vector<int>& document_ids) {
+    if (document_ids.empty()) {
+        return;
+    }
+    if (is_compressed_) {
+        postings_[term_id] = compressed_postings_[term_id].Decompress();
+    }
+
+    auto& postings = postings_[term_id];
+    auto document_it = document_ids.begin();
+    postings.erase(std::remove_if(postings.begin(), postings.end(), [&document_it, &document_ids](const Posting& posting) {
+        while (document_it != document_ids.end() && *document_it < posting.document_id) {
+            ++document_it;
+        }
+        return document_it != document_ids.end() && *document_it == posting.document_id;
+    }), postings.end());
+    UpdateMaxTermFreq(term_id, postings);
+    FinishRemoval(term_id);
+}
+
+void InvertedIndex::ReleaseEmptyTerm(TermId term_id) {
+    const auto it = term_to_id_.find(GetTerm(term_id));
+    if (GetDocumentFreq(term_id) > 0 || it == term_to_id_.end() || it->second != term_id) {
+        return;
+    }
+    term_to_id_.erase(it);
+    term_storage_.Release(terms_[term_id]);
+    terms_[term_id] = {0, 0, 0};
+    max_term_freqs_[term_id] = 0.0;
+    free_term_ids_.push_back(term_id);
+    if (term_storage_.NeedsCompaction()) {
+        CompactTerms();
+    }
+}
+
+bool InvertedIndex::HasPosting(TermId term_id, int document_id) const {
+    if (is_compressed_) {
+        return compressed_postings_[term_id].Contains(document_id);
+    }
+    const auto& postings = postings_[term_id];
+    const auto it = FindPosting(postings, document_id);
+    return it != postings.end() && it->document_id == document_id;
+}
+
+void InvertedIndex::RenumberDocuments(const std::vector<int>& new_document_ids) {
+    std::vector<TermId> term_ids(terms_.size());
+    std::iota(term_ids.begin(), term_ids.end(), TermId{0});
+    std::for_each(std::execution::par, term_ids.begin(), term_ids.end(), [this, &new_document_ids](TermId term_id) {
+        if (is_compressed_) {
+            if (compressed_postings_[term_id].IsEmpty()) {
+                return;
+            }
+            postings_[term_id] = compressed_postings_[term_id].Decompress();
+        }
+        auto& postings = postings_[term_id];
+        for (Posting& posting : postings) {
+            posting.document_id = new_document_ids[posting.document_id];
+        }
+        if (is_compressed_) {
+            compressed_postings_[term_id] = CompressedPostingList(postings);
+            std::vector<Posting>().swap(postings);
+        }
+    });
+}
+
+PostingCursor InvertedIndex::GetCursor(TermId term_id) const {
+    if (is_compressed_) {
+        return PostingCursor(compressed_postings_[term_id]);
+    }
+    return PostingCursor(postings_[term_id]);
+}
+
+size_t InvertedIndex::GetDocumentFreq(TermId term_id) const {
+    return is_compressed_ ? compressed_postings_[term_id].GetSize() : postings_[term_id].size();
+}
+
+double InvertedIndex::GetMaxTermFreq(TermId term_id) const {
+    return max_term_freqs_[term_id];
+}
+
+double InvertedIndex::GetLogDocumentFreq(TermId term_id) const {
+    return log_document_freqs_[term_id];
+}
+
+void InvertedIndex::SetCompression(bool is_compressed) {
+    if (is_compressed_ == is_compressed) {
+        return;
+    }
+    for (TermId term_id = 0; term_id < terms_.size(); ++term_id) {
+        if (is_compressed) {
+            compressed_postings_[term_id] = CompressedPostingList(postings_[term_id]);
+            std::vector<Posting>().swap(postings_[term_id]);
+        } else {
+            postings_[term_id] = compressed_postings_[term_id].Decompress();
+            compressed_postings_[term_id] = CompressedPostingList();
+        }
+    }
+    is_compressed_ = is_compressed;
+}
+
+bool InvertedIndex::IsCompressed() const {
+    return is_compressed_;
+}
+
+PostingStats InvertedIndex::GetPostingStats() const {
+    PostingStats stats{0, 0};
+    for (TermId term_id = 0; term_id < terms_.size(); ++term_id) {
+        stats.posting_count += GetDocumentFreq(term_id);
+        stats.byte_count += is_compressed_
+                            ? compressed_postings_[term_id].GetByteSize()
+                            : postings_[term_id].capacity() * sizeof(Posting);
+    }
+    return stats;
+}
+
+void InvertedIndex::RebuildTermMap() {
+    std::vector<bool> is_free(terms_.size(), false);
+    for (const TermId term_id : free_term_ids_) {
+        is_free[term_id] = true;
+    }
+    term_to_id_.clear();
+    term_to_id_.reserve(terms_.size() - free_term_ids_.size());
+    for (TermId term_id = 0; term_id < terms_.size(); ++term_id) {
+        if (!is_free[term_id]) {
+            term_to_id_.emplace(GetTerm(term_id), term_id);
+        }
+    }
+}
+
+// Строки действующих термов переносятся в новое хранилище, блоки старого освобождаются целиком
+void InvertedIndex::CompactTerms() {
+    StringArena term_storage;
+    for (const auto& [word, term_id] : term_to_id_) {
+        terms_[term_id] = term_storage.Add(word);
+    }
+    term_storage_ = std::move(term_storage);
+    RebuildTermMap();
+}
+
+void InvertedIndex::UpdateLogDocumentFreq(TermId term_id) {
+    log_document_freqs_[term_id] = log(static_cast<double>(GetDocumentFreq(term_id)));
+}
+
+void InvertedIndex::UpdateMaxTermFreq(TermId term_id, const std::vector<Posting>& postings) {
+    double max_term_freq = 0.0;
+    for (const Posting& posting : postings) {
+        max_term_freq = std::max(max_term_freq, posting.term_freq);
+    }
+    max_term_freqs_[term_id] = max_term_freq;
+}
+
+void InvertedIndex::FinishRemoval(TermId term_id) {
+    auto& postings = postings_[term_id];
+    if (is_compressed_) {
+        compressed_postings_[term_id] = CompressedPostingList(postings);
+        std::vector<Posting>().swap(postings);
+    } else if (postings.empty()) {
+        std::vector<Posting>().swap(postings);
+    } else if (postings.size() * 4 < postings.capacity()) {
+        postings.shrink_to_fit();
+    }
+    UpdateLogDocumentFreq(term_id);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "posting_list.h"
+#include "string_arena.h"
+
+struct PostingStats {
+    size_t posting_count;
+    size_t byte_count;
+};
+
+// Инвертированный индекс: словарь термов и плотные, отсортированные по id документа списки вхождений.
+// Списки могут храниться в сжатом виде: добавление документа с наибольшим id остаётся дешёвым,
+// прочие изменения пересжимают список терма целиком
+class InvertedIndex {
+public:
+    using TermId = uint32_t;
+
+    InvertedIndex() = default;
+    InvertedIndex(const InvertedIndex& other);
+    InvertedIndex& operator=(const InvertedIndex& other);
+    InvertedIndex(InvertedIndex&&) = default;
+    InvertedIndex& operator=(InvertedIndex&&) = default;
+
+    TermId AddTerm(std::string_view word);
+    std::optional<TermId> FindTerm(std::string_view word) const;
+    std::string_view GetTerm(TermId term_id) const;
+    // Число выданных id термов, включая освобождённые
+    size_t GetTermCount() const;
+
+    void AddPosting(TermId term_id, int document_id, double term_freq);
+    // Вхождения упорядочены по id документа, документов ещё нет в списке терма
+    void AddPostings(TermId term_id, const std::vector<Posting>& postings);
+    void RemovePosting(TermId term_id, int document_id);
+    // document_ids упорядочены по возрастанию; список терма пересобирается за один проход
+    void RemovePostings(TermId term_id, const std::vector<int>& document_ids);
+    // Терм без вхождений удаляется из словаря, его id и строка переиспользуются.
+    // Списки разных термов можно менять параллельно, а словарь — только из одного потока
+    void ReleaseEmptyTerm(TermId term_id);
+    bool HasPosting(TermId term_id, int document_id) const;
+    // Заменяет id документа d на new_document_ids[d]; замена должна сохранять порядок id в списках
+    void RenumberDocuments(const std::vector<int>& new_document_ids);
+
+    PostingCursor GetCursor(TermId term_id) const;
+    size_t GetDocumentFreq(TermId term_id) const;
+    // Верхняя граница частоты терма по всем документам, нужна для отсечения при поиске
+    double GetMaxTermFreq(TermId term_id) const;
+    // log(GetDocumentFreq), пересчитывается при изменении списка терма, чтобы IDF обходился без логарифма
+    double GetLogDocumentFreq(TermId term_id) const;
+
+    void SetCompression(bool is_compressed);
+    bool IsCompressed() const;
+    PostingStats GetPostingStats() const;
+
+private:
+    StringArena term_storage_;
+    std::vector<StringArena::StringRef> terms_;
+    std::unordered_map<std::string_view, TermId> term_to_id_;
+    std::vector<std::vector<Posting>> postings_;
+    std::vector<CompressedPostingList> compressed_postings_;
+    std::vector<double> max_term_freqs_;
+    std::vector<double> log_document_freqs_;
+    std::vector<TermId> free_term_ids_;
+    bool is_compressed_ = false;
+
+    void RebuildTermMap();
+    void CompactTerms();
+    void UpdateMaxTermFreq(TermId term_id, const std::vector<Posting>& postings);
+    void UpdateLogDocumentFreq(TermId term_id);
+    // Сжимает список после удалений: пустой освобождается целиком, сильно опустевший — ужимается
+    void FinishRemoval(TermId term_id);
+};
@@ -1,12 +1,28 @@
 #include "search_server.h"
+#include "index_snapshot.h"
+#include "cached_search_server.h"
+#include "concurrent_search_server.h"
+#include "segmented_search_server.h"
+#include "remove_duplicates.h"
 #include "process_queries.h"
 #include "log_duration.h"
+#include "test_example_functions.h"
 
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <malloc.h>
+#include <numeric>
+#include <optional>
+#include <set>
 #include <string>
 #include <vector>
+#include <chrono>
 #include <execution>
 #include <random>
+#include <thread>
 
 using namespace std;
 
@@ -44,42 +60,435 @@ string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int w
     return query;
 }
 
-vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
+vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count, double minus_prob = 0) {
     vector<string> queries;
     queries.reserve(query_count);
     for (int i = 0; i < query_count; ++i) {
-        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
+        queries.push_back(GenerateQuery(generator, dictionary, max_word_count, minus_prob));
     }
     return queries;
 }
 
-template <typename ExecutionPolicy>
-void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
+template <typename ExecutionPolicy, typename... Filter>
+void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy, const Filter&... filter) {
     LOG_DURATION(static_cast<string>(mark));
     double total_relevance = 0;
     for (const string_view query : queries) {
-        for (const auto& document : search_server.FindTopDocuments(policy, query)) {
+        for (const auto& document : search_server.FindTopDocuments(policy, query, filter...)) {
             total_relevance += document.relevance;
         }
     }
     cout << total_relevance << endl;
 }
 
+void BenchmarkBatchIngest(const string& stop_words, const vector<string>& documents) {
+    vector<NewDocument> batch;
+    batch.reserve(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        batch.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+    }
+    for (const size_t thread_count : {1, 2, 4, 8}) {
+        SearchServer search_server(stop_words);
+        const auto start = chrono::steady_clock::now();
+        search_server.AddDocuments(batch, thread_count);
+        const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        cout << "AddDocuments, "s << thread_count << " threads: "s
+             << static_cast<int>(batch.size() / elapsed.count()) << " docs/s"s << endl;
+    }
+}
+
+// Читатели ищут в опубликованных снимках, пока писатель заменяет документы. Каждая публикация удаляет
+// и добавляет поровну документов, поэтому читатель, увидевший частично применённые изменения, заметит другое их число
+void StressConcurrentServer(const SearchServer& search_server, const vector<string>& documents, const vector<string>& queries) {
+    ConcurrentSearchServer concurrent_server(search_server);
+    const int document_count = concurrent_server.GetDocumentCount();
+    atomic<bool> is_writing = true;
+    atomic<int> query_count = 0;
+    atomic<int> error_count = 0;
+    atomic<long long> max_latency_us = 0;
+
+    vector<thread> readers;
+    for (int reader = 0; reader < 4; ++reader) {
+        readers.emplace_back([&, reader] {
+            for (size_t i = reader; is_writing; i = (i + 1) % queries.size()) {
+                const auto start = chrono::steady_clock::now();
+                const auto snapshot = concurrent_server.GetSnapshot();
+                if (snapshot->GetDocumentCount() != document_count) {
+                    ++error_count;
+                }
+                for (const Document& document : snapshot->FindTopDocuments(queries[i])) {
+                    if (get<0>(snapshot->MatchDocument(queries[i], document.id)).empty()) {
+                        ++error_count;
+                    }
+                }
+                const long long latency_us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+                long long current_max = max_latency_us;
+                while (latency_us > current_max && !max_latency_us.compare_exchange_weak(current_max, latency_us)) {
+                }
+                ++query_count;
+            }
+        });
+    }
+
+    const int batch_size = 100;
+    const int publish_count = 20;
+    const auto start = chrono::steady_clock::now();
+    for (int round = 0; round < publish_count; ++round) {
+        for (int i = 0; i < batch_size; ++i) {
+            const int removed_id = round * batch_size + i;
+            concurrent_server.RemoveDocument(removed_id);
+            concurrent_server.AddDocument(document_count + removed_id, documents[removed_id], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        concurrent_server.Publish();
+    }
+    const chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    is_writing = false;
+    for (thread& reader : readers) {
+        reader.join();
+    }
+    cout << "concurrent: "s << publish_count << " publishes in "s << static_cast<int>(elapsed.count()) << " ms, "s
+         << query_count << " queries, max query latency "s << max_latency_us / 1000 << " ms, errors: "s << error_count << endl;
+}
+
+// Скользящее окно: каждый новый документ вытесняет самый старый, между записями идут запросы
+template <typename Server>
+void BenchmarkContinuousWrites(string_view mark, Server& server, const vector<string>& documents, const vector<string>& queries) {
+    const size_t window_size = documents.size() / 2;
+    long long max_write_us = 0;
+    double total_relevance = 0;
+    const auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const auto write_start = chrono::steady_clock::now();
+        server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        if (i >= window_size) {
+            server.RemoveDocument(i - window_size);
+        }
+        max_write_us = max<long long>(max_write_us, chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - write_start).count());
+        if (i % 100 == 0) {
+            for (const auto& document : server.FindTopDocuments(queries[i / 100 % queries.size()])) {
+                total_relevance += document.relevance;
+            }
+        }
+    }
+    const chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    cout << total_relevance << endl;
+    cout << mark << ": "s << static_cast<int>(elapsed.count()) << " ms, max write latency "s << max_write_us << " us"s << endl;
+}
+
+size_t GetResidentMemoryKb() {
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.rfind("VmRSS:", 0) == 0) {
+            return stoul(line.substr(line.find_first_of("0123456789")));
+        }
+    }
+    return 0;
+}
+
+// Удаление всех документов должно вернуть память процесса к исходной. malloc_trim отдаёт системе
+// освобождённые, но удерживаемые аллокатором страницы, иначе RSS не показывает освобождение
+void BenchmarkRemoval(const string& stop_words, const vector<string>& documents) {
+    vector<int> document_ids(documents.size());
+    iota(document_ids.begin(), document_ids.end(), 0);
+    malloc_trim(0);
+    const size_t memory_before = GetResidentMemoryKb();
+    for (const bool is_batch : {false, true}) {
+        {
+            SearchServer search_server(stop_words);
+            for (size_t i = 0; i < documents.size(); ++i) {
+                search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+            }
+            const size_t memory_full = GetResidentMemoryKb();
+            const auto start = chrono::steady_clock::now();
+            if (is_batch) {
+                search_server.RemoveDocuments(document_ids);
+            } else {
+                for (const int document_id : document_ids) {
+                    search_server.RemoveDocument(document_id);
+                }
+            }
+            const chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+            malloc_trim(0);
+            cout << (is_batch ? "RemoveDocuments: "s : "RemoveDocument: "s) << static_cast<int>(elapsed.count()) << " ms, index memory "s
+                 << memory_full - memory_before << " KB -> "s << static_cast<long long>(GetResidentMemoryKb()) - static_cast<long long>(memory_before) << " KB"s << endl;
+        }
+    }
+}
+
+constexpr StaticStopWordSet ENGLISH_STOP_WORDS(array<string_view, 32>{
+    "a", "an", "and", "are", "as", "at", "be", "but", "by", "for", "from", "if", "in", "into", "is", "it",
+    "no", "not", "of", "on", "or", "such", "that", "the", "their", "then", "there", "these", "they", "this", "to", "with"});
+static_assert(ENGLISH_STOP_WORDS.Contains("the") && !ENGLISH_STOP_WORDS.Contains("cat"));
+
+// Поиск каждого слова документов среди 600 стоп-слов: прежнее дерево против хеш-таблицы
+void BenchmarkStopWords(const vector<string>& dictionary, const vector<string>& documents) {
+    const set<string, less<>> stop_word_tree(dictionary.begin(), dictionary.begin() + min<size_t>(600, dictionary.size()));
+    const StopWordSet stop_word_set(stop_word_tree);
+    const StopWordSet static_stop_word_set(ENGLISH_STOP_WORDS);
+    vector<string_view> words;
+    for (const string& document : documents) {
+        SplitIntoWords(document, words);
+    }
+    const auto count_stop_words = [&words](string_view mark, const auto& contains) {
+        LOG_DURATION(static_cast<string>(mark));
+        size_t stop_word_count = 0;
+        for (int i = 0; i < 10; ++i) {
+            for (const string_view word : words) {
+                stop_word_count += contains(word);
+            }
+        }
+        cout << stop_word_count << " stop words"s << endl;
+    };
+    count_stop_words("stop words, std::set"s, [&](string_view word) {return stop_word_tree.count(word) > 0;});
+    count_stop_words("stop words, StopWordSet"s, [&](string_view word) {return stop_word_set.Contains(word);});
+    count_stop_words("stop words, StopWordSet from constexpr list"s, [&](string_view word) {return static_stop_word_set.Contains(word);});
+}
+
+void BenchmarkTokenizer(const vector<string>& documents) {
+    LOG_DURATION("tokenize x20"s);
+    vector<string_view> words;
+    size_t word_count = 0;
+    for (int i = 0; i < 20; ++i) {
+        for (const string& document : documents) {
+            words.clear();
+            SplitIntoWords(document, words);
+            word_count += words.size();
+        }
+    }
+    cout << word_count << " words"s << endl;
+}
+
+// Каждый десятый документ — копия одного из предыдущих: половина с переставленными словами,
+// половина с одним заменённым словом
+void BenchmarkDeduplication(mt19937& generator, const vector<string>& dictionary, int document_count) {
+    vector<string> documents = GenerateQueries(generator, dictionary, document_count, 10);
+    for (size_t i = 1; i < documents.size(); ++i) {
+        if (uniform_int_distribution(0, 9)(generator) != 0) {
+            continue;
+        }
+        vector<string_view> words = SplitIntoWords(documents[uniform_int_distribution<size_t>(0, i - 1)(generator)]);
+        if (uniform_int_distribution(0, 1)(generator) == 0) {
+            shuffle(words.begin(), words.end(), generator);
+        } else {
+            words[uniform_int_distribution<size_t>(0, words.size() - 1)(generator)] = dictionary[uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator)];
+        }
+        string document;
+        for (const string_view word : words) {
+            if (!document.empty()) {
+                document.push_back(' ');
+            }
+            document += word;
+        }
+        documents[i] = move(document);
+    }
+
+    vector<NewDocument> new_documents;
+    new_documents.reserve(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        new_documents.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+    }
+    SearchServer search_server(""s);
+    {
+        LOG_DURATION("dedup: AddDocuments"s);
+        search_server.AddDocuments(new_documents);
+    }
+    for (const double min_similarity : {1.0, 0.8}) {
+        LOG_DURATION("dedup: FindDuplicateGroups"s);
+        const auto groups = FindDuplicateGroups(search_server, min_similarity);
+        size_t duplicate_count = 0;
+        for (const auto& group : groups) {
+            duplicate_count += group.size() - 1;
+        }
+        cout << "similarity "s << min_similarity << ": "s << groups.size() << " groups, "s << duplicate_count << " duplicates"s << endl;
+    }
+    LOG_DURATION("dedup: RemoveDuplicates"s);
+    const size_t removed_count = RemoveDuplicates(search_server).size();
+    cout << "removed "s << removed_count << ", left "s << search_server.GetDocumentCount() << endl;
+}
+
+// Запросы из одного словаря делят термы: пакетное выполнение обходит каждый список вхождений один раз
+void BenchmarkQueryBatch(const SearchServer& search_server, const vector<string>& queries) {
+    size_t document_count = 0;
+    {
+        LOG_DURATION("queries one by one"s);
+        vector<vector<Document>> results(queries.size());
+        transform(execution::par, queries.begin(), queries.end(), results.begin(), [&search_server](const string& query) {
+            return search_server.FindTopDocuments(query);
+        });
+        for (const auto& documents : results) {
+            document_count += documents.size();
+        }
+    }
+    {
+        LOG_DURATION("ProcessQueries, batched"s);
+        for (const auto& documents : ProcessQueries(search_server, queries)) {
+            document_count -= documents.size();
+        }
+    }
+    {
+        LOG_DURATION("ProcessQueriesJoined, streaming"s);
+        ProcessQueriesJoined(search_server, queries, [&document_count](const Document&) {
+            ++document_count;
+        }, 16);
+    }
+    cout << document_count << " documents"s << endl;
+}
+
 #define TEST(policy) Test(#policy, search_server, queries, execution::policy)
 
+// Фразы из двух соседних слов документов: проверка подстрокой в тексте против позиционного индекса
+void BenchmarkPhraseQueries(mt19937& generator, SearchServer& search_server, const vector<string>& documents, int query_count) {
+    vector<string> phrases;
+    vector<string_view> words;
+    while (static_cast<int>(phrases.size()) < query_count) {
+        SplitIntoWords(documents[uniform_int_distribution<size_t>(0, documents.size() - 1)(generator)], words);
+        if (words.size() >= 2) {
+            const size_t first = uniform_int_distribution<size_t>(0, words.size() - 2)(generator);
+            phrases.push_back(string(words[first]) + " "s + string(words[first + 1]));
+        }
+    }
+
+    size_t found_count = 0;
+    {
+        LOG_DURATION("phrases, substring scan"s);
+        for (const string& phrase : phrases) {
+            found_count += search_server.FindTopDocuments(phrase, [&documents, &phrase](int document_id, DocumentStatus, int) {
+                return documents[document_id].find(phrase) != string::npos;
+            }).size();
+        }
+    }
+    cout << found_count << endl;
+
+    {
+        LOG_DURATION("position index build"s);
+        search_server.SetPositionIndexing(true);
+    }
+    const PositionStats stats = search_server.GetPositionStats();
+    cout << "positions: "s << stats.position_count << ", "s << stats.byte_count / 1024 << " KB, "s
+         << static_cast<double>(stats.byte_count) / stats.position_count << " bytes per position"s << endl;
+    found_count = 0;
+    {
+        LOG_DURATION("phrases, position index"s);
+        for (const string& phrase : phrases) {
+            found_count += search_server.FindTopDocuments("\""s + phrase + "\""s).size();
+        }
+    }
+    cout << found_count << endl;
+    search_server.SetPositionIndexing(false);
+}
+
 int main() {
     mt19937 generator;
 
     const auto dictionary = GenerateDictionary(generator, 1000, 10);
     const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
 
+    const size_t memory_before = GetResidentMemoryKb();
     SearchServer search_server(dictionary[0]);
-    for (size_t i = 0; i < documents.size(); ++i) {
-        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    {
+        LOG_DURATION("index build"s);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
     }
+    cout << "index memory: "s << GetResidentMemoryKb() - memory_before << " KB"s << endl;
+    BenchmarkTokenizer(documents);
+    BenchmarkStopWords(dictionary, documents);
+    BenchmarkBatchIngest(dictionary[0], documents);
+    BenchmarkRemoval(dictionary[0], documents);
+    BenchmarkDeduplication(generator, dictionary, 1'000'000);
 
     const auto queries = GenerateQueries(generator, dictionary, 100, 70);
 
     TEST(seq);
     TEST(par);
+    Test("max_score"s, search_server, queries, search_policy::max_score);
+    Test("bm25, seq"s, search_server, queries, search_policy::Bm25{execution::seq});
+    Test("bm25, max_score"s, search_server, queries, search_policy::Bm25{search_policy::max_score});
+    BenchmarkQueryBatch(search_server, queries);
+    BenchmarkPhraseQueries(generator, search_server, documents, 100);
+    TestNearSameWord();
+    TestMalformedNearIsWord();
+    TestSlotCompaction(dictionary[0], documents, queries);
+
+    const auto minus_queries = GenerateQueries(generator, dictionary, 100, 70, 0.3);
+    Test("seq, minus words"s, search_server, minus_queries, execution::seq);
+    Test("max_score, minus words"s, search_server, minus_queries, search_policy::max_score);
+
+    Test("seq, rating lambda"s, search_server, queries, execution::seq,
+         [](int, DocumentStatus status, int rating) {return status == DocumentStatus::ACTUAL && rating >= 2;});
+    Test("seq, rating filter"s, search_server, queries, execution::seq, DocumentFilter{DocumentStatus::ACTUAL, 2, nullopt});
+
+    {
+        // Тяжёлый хвост: на один запрос из ста приходится 40% трафика
+        vector<string> traffic;
+        for (int i = 0; i < 1000; ++i) {
+            const bool is_popular = uniform_real_distribution<>(0, 1)(generator) < 0.4;
+            traffic.push_back(queries[is_popular ? 0 : uniform_int_distribution<size_t>(0, queries.size() - 1)(generator)]);
+        }
+        Test("seq, heavy-tailed traffic"s, search_server, traffic, execution::seq);
+        CachedSearchServer cached_search_server(search_server, 64);
+        {
+            LOG_DURATION("cached, heavy-tailed traffic"s);
+            double total_relevance = 0;
+            for (const string_view query : traffic) {
+                for (const auto& document : cached_search_server.FindTopDocuments(query)) {
+                    total_relevance += document.relevance;
+                }
+            }
+            cout << total_relevance << endl;
+        }
+        const CacheStats stats = cached_search_server.GetStats();
+        cout << "cache hits: "s << stats.hit_count << ", misses: "s << stats.miss_count << endl;
+    }
+
+    StressConcurrentServer(search_server, documents, queries);
+
+    {
+        SearchServer plain_server(dictionary[0]);
+        BenchmarkContinuousWrites("continuous writes, SearchServer"s, plain_server, documents, queries);
+        SegmentedSearchServer segmented_server(dictionary[0]);
+        BenchmarkContinuousWrites("continuous writes, SegmentedSearchServer"s, segmented_server, documents, queries);
+        cout << "segments: "s << segmented_server.GetSegmentCount() << endl;
+    }
+
+    {
+        const string snapshot_path = (filesystem::temp_directory_path() / "search_server.idx").string();
+        {
+            LOG_DURATION("snapshot save"s);
+            IndexSnapshot::Save(search_server, snapshot_path);
+        }
+        optional<IndexSnapshot> snapshot;
+        {
+            LOG_DURATION("snapshot open"s);
+            snapshot.emplace(snapshot_path);
+        }
+        {
+            LOG_DURATION("snapshot queries"s);
+            double total_relevance = 0;
+            for (const string_view query : queries) {
+                for (const auto& document : snapshot->FindTopDocuments(query)) {
+                    total_relevance += document.relevance;
+                }
+            }
+            cout << total_relevance << endl;
+        }
+        TestSnapshotRoundTrip(search_server, *snapshot, queries);
+        TestSnapshotRoundTrip(search_server, *snapshot, minus_queries);
+        TestSnapshotRejectsCorruption(snapshot_path);
+        remove(snapshot_path.c_str());
+    }
+
+    for (const bool is_compressed : {false, true}) {
+        search_server.SetPostingCompression(is_compressed);
+        const PostingStats stats = search_server.GetPostingStats();
+        cout << (is_compressed ? "compressed"s : "plain"s) << " postings: "s
+             << static_cast<double>(stats.byte_count) / stats.posting_count << " bytes per posting"s << endl;
+        TEST(seq);
+        Test("max_score"s, search_server, queries, search_policy::max_score);
+    }
+#ifdef SEARCH_SERVER_INSTRUMENTATION
+    QueryStats::GetInstance().Print(cout);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "position_index.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "posting_list.h"
+
+DocumentPositions::DocumentPositions(const std::vector<std::vector<uint32_t>>& term_positions) {
+    offsets_.reserve(term_positions.size() + 1);
+    for (const auto& positions : term_positions) {
+        offsets_.push_back(static_cast<uint32_t>(bytes_.size()));
+        uint32_t previous = 0;
+        for (const uint32_t position : positions) {
+            WriteVarint(bytes_, position - previous);
+            previous = position;
+        }
+        position_count_ += positions.size();
+    }
+    offsets_.push_back(static_cast<uint32_t>(bytes_.size()));
+    offsets_.shrink_to_fit();
+    bytes_.shrink_to_fit();
+}
+
+void DocumentPositions::Decode(size_t term_index, std::vector<uint32_t>& positions) const {
+    positions.clear();
+    const uint8_t* data = bytes_.data() + offsets_[term_index];
+    const uint8_t* end = bytes_.data() + offsets_[term_index + 1];
+    uint32_t position = 0;
+    while (data != end) {
+        position += ReadVarint(data);
+        positions.push_back(position);
+    }
+}
+
+size_t DocumentPositions::GetPositionCount() const {
+    return position_count_;
+}
+
+size_t DocumentPositions::GetByteSize() const {
+    return sizeof(DocumentPositions) + offsets_.capacity() * sizeof(uint32_t) + bytes_.capacity();
+}
+
+void PositionIndex::AddDocument(int slot, DocumentPositions positions) {
+    if (static_cast<size_t>(slot) >= slot_positions_.size()) {
+        slot_positions_.resize(slot + 1);
+    }
+    slot_positions_[slot] = std::move(positions);
+}
+
+void PositionIndex::RemoveDocument(int slot) {
+    slot_positions_[slot] = DocumentPositions();
+}
+
+const DocumentPositions& PositionIndex::GetDocumentPositions(int slot) const {
+    return slot_positions_[slot];
+}
+
+void PositionIndex::RenumberSlots(const std::vector<int>& new_slots) {
+    std::vector<DocumentPositions> slot_positions;
+    for (size_t slot = 0; slot < slot_positions_.size(); ++slot) {
+        if (new_slots[slot] != -1) {
+            if (static_cast<size_t>(new_slots[slot]) >= slot_positions.size()) {
+                slot_positions.resize(new_slots[slot] + 1);
+            }
+            slot_positions[new_slots[slot]] = std::move(slot_positions_[slot]);
+        }
+    }
+    slot_positions_ = std::move(slot_positions);
+}
+
+PositionStats PositionIndex::GetStats() const {
+    PositionStats stats{0, 0};
+    for (const DocumentPositions& positions : slot_positions_) {
+        stats.position_count += positions.GetPositionCount();
+        stats.byte_count += positions.GetByteSize();
+    }
+    return stats;
+}
+
+bool MatchPositions(const std::vector<std::vector<uint32_t>>& term_positions, const std::vector<uint32_t>& offsets,
+                    uint32_t max_distance) {
+    // Позиции, приведённые к началу фразы
+    const auto to_starts = [&](size_t i) {
+        std::vector<int64_t> starts(term_positions[i].size());
+        std::transform(term_positions[i].begin(), term_positions[i].end(), starts.begin(), [&offsets, i](uint32_t position) {
+            return static_cast<int64_t>(position) - offsets[i];
+        });
+        return starts;
+    };
+
+    if (max_distance > 0) {
+        const std::vector<int64_t> lhs = to_starts(0);
+        const std::vector<int64_t> rhs = to_starts(1);
+        auto rhs_it = rhs.begin();
+        for (const int64_t start : lhs) {
+            while (rhs_it != rhs.end() && *rhs_it + max_distance < start) {
+                ++rhs_it;
+            }
+            // Разные слова не стоят на одном месте, а одно и то же вхождение не пара самому себе
+            auto pair_it = rhs_it;
+            if (pair_it != rhs.end() && *pair_it == start) {
+                ++pair_it;
+            }
+            if (pair_it != rhs.end() && *pair_it <= start + max_distance) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<int64_t> starts = to_starts(0);
+    std::vector<int64_t> buffer;
+    for (size_t i = 1; i < term_positions.size() && !starts.empty(); ++i) {
+        const std::vector<int64_t> term_starts = to_starts(i);
+        buffer.clear();
+        std::set_intersection(starts.begin(), starts.end(), term_starts.begin(), term_starts.end(), std::back_inserter(buffer));
+        starts.swap(buffer);
+    }
+    return !starts.empty();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct PositionStats {
+    size_t position_count;
+    size_t byte_count;
+};
+
+// Позиции слов одного документа. Для каждого терма документа, в порядке id термов, хранятся
+// возрастающие номера слов текста, записанные разностями в varint
+class DocumentPositions {
+public:
+    DocumentPositions() = default;
+    // term_positions[i] — позиции i-го по id терма документа
+    explicit DocumentPositions(const std::vector<std::vector<uint32_t>>& term_positions);
+
+    // Заменяет содержимое positions позициями терма с номером term_index
+    void Decode(size_t term_index, std::vector<uint32_t>& positions) const;
+
+    size_t GetPositionCount() const;
+    size_t GetByteSize() const;
+
+private:
+    // Начало позиций каждого терма в bytes_ и конец позиций последнего
+    std::vector<uint32_t> offsets_;
+    std::vector<uint8_t> bytes_;
+    size_t position_count_ = 0;
+};
+
+// Необязательный позиционный слой индекса для фраз и NEAR/k. Номера позиций считаются
+// вместе со стоп-словами, поэтому стоп-слово внутри фразы оставляет в ней пропуск.
+// Документы адресуются слотами, как столбцы SearchServer
+class PositionIndex {
+public:
+    void AddDocument(int slot, DocumentPositions positions);
+    void RemoveDocument(int slot);
+    const DocumentPositions& GetDocumentPositions(int slot) const;
+    // Позиции слота s переходят в слот new_slots[s]; слоты со значением -1 пусты
+    void RenumberSlots(const std::vector<int>& new_slots);
+
+    // Память позиций вместе с пустыми ячейками освобождённых слотов
+    PositionStats GetStats() const;
+
+private:
+    std::vector<DocumentPositions> slot_positions_;
+};
+
+// Стоят ли слова на местах start + offsets[i] при некотором start. При max_distance > 0 слов два,
+// и их места start + offsets[i] могут расходиться не больше чем на max_distance в любую сторону,
+// но не совпадать: у одинаковых слов это два разных вхождения
+bool MatchPositions(const std::vector<std::vector<uint32_t>>& term_positions, const std::vector<uint32_t>& offsets,
+                    uint32_t max_distance);
@@ -0,0 +1,199 @@
+#include "posting_list.h"
+
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <utility>
+
+void WriteVarint(std::vector<uint8_t>& bytes, uint32_t value) {
+    while (value >= 0x80) {
+        bytes.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t ReadVarint(const uint8_t*& data) {
+    uint32_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        const uint8_t byte = *data++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            return value;
+        }
+    }
+}
+
+namespace {
+
+bool IsBefore(const Posting& posting, int document_id) {
+    return posting.document_id < document_id;
+}
+
+} // namespace
+
+CompressedPostingList::CompressedPostingList(const std::vector<Posting>& postings) {
+    // Самые частые значения частоты получают самые короткие коды
+    std::map<double, size_t> term_freq_counts;
+    for (const Posting& posting : postings) {
+        ++term_freq_counts[posting.term_freq];
+    }
+    std::vector<std::pair<size_t, double>> by_count;
+    by_count.reserve(term_freq_counts.size());
+    for (const auto& [term_freq, count] : term_freq_counts) {
+        by_count.emplace_back(count, term_freq);
+    }
+    std::sort(by_count.begin(), by_count.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first > rhs.first;
+    });
+    std::map<double, uint32_t> codes;
+    for (const auto& [count, term_freq] : by_count) {
+        codes.emplace(term_freq, static_cast<uint32_t>(term_freqs_.size()));
+        term_freqs_.push_back(term_freq);
+    }
+
+    for (const Posting& posting : postings) {
+        AppendCode(posting.document_id, codes.at(posting.term_freq));
+    }
+    bytes_.shrink_to_fit();
+    blocks_.shrink_to_fit();
+}
+
+void CompressedPostingList::Append(int document_id, double term_freq) {
+    AppendCode(document_id, GetTermFreqCode(term_freq));
+}
+
+std::vector<Posting> CompressedPostingList::Decompress() const {
+    std::vector<Posting> postings;
+    postings.reserve(size_);
+    std::vector<Posting> block;
+    for (size_t block_index = 0; block_index < blocks_.size(); ++block_index) {
+        DecodeBlock(block_index, block);
+        postings.insert(postings.end(), block.begin(), block.end());
+    }
+    return postings;
+}
+
+size_t CompressedPostingList::GetSize() const {
+    return size_;
+}
+
+bool CompressedPostingList::IsEmpty() const {
+    return size_ == 0;
+}
+
+int CompressedPostingList::GetLastDocumentId() const {
+    return blocks_.back().last_document_id;
+}
+
+size_t CompressedPostingList::GetByteSize() const {
+    return bytes_.capacity() + blocks_.capacity() * sizeof(Block) + term_freqs_.capacity() * sizeof(double)
+           + sorted_term_freq_codes_.capacity() * sizeof(uint32_t);
+}
+
+size_t CompressedPostingList::GetBlockCount() const {
+    return blocks_.size();
+}
+
+size_t CompressedPostingList::FindBlock(int document_id, size_t first_block) const {
+    const auto it = std::lower_bound(blocks_.begin() + std::min(first_block, blocks_.size()), blocks_.end(), document_id,
+                                     [](const Block& block, int id) { return block.last_document_id < id; });
+    return it - blocks_.begin();
+}
+
+void CompressedPostingList::DecodeBlock(size_t block_index, std::vector<Posting>& postings) const {
+    const Block& block = blocks_[block_index];
+    const size_t count = block_index + 1 < blocks_.size() ? BLOCK_SIZE : size_ - block_index * BLOCK_SIZE;
+    postings.resize(count);
+    const uint8_t* data = bytes_.data() + block.offset;
+    int document_id = block.first_document_id;
+    for (Posting& posting : postings) {
+        document_id += static_cast<int>(ReadVarint(data));
+        posting.document_id = document_id;
+        posting.term_freq = term_freqs_[ReadVarint(data)];
+    }
+}
+
+bool CompressedPostingList::Contains(int document_id) const {
+    const size_t block_index = FindBlock(document_id);
+    if (block_index == blocks_.size() || blocks_[block_index].first_document_id > document_id) {
+        return false;
+    }
+    std::vector<Posting> block;
+    DecodeBlock(block_index, block);
+    return std::binary_search(block.begin(), block.end(), Posting{document_id, 0.0},
+                              [](const Posting& lhs, const Posting& rhs) { return lhs.document_id < rhs.document_id; });
+}
+
+uint32_t CompressedPostingList::GetTermFreqCode(double term_freq) {
+    if (term_freqs_.size() <= MAX_SCANNED_TERM_FREQS) {
+        const auto it = std::find(term_freqs_.begin(), term_freqs_.end(), term_freq);
+        if (it != term_freqs_.end()) {
+            return static_cast<uint32_t>(it - term_freqs_.begin());
+        }
+        term_freqs_.push_back(term_freq);
+        return static_cast<uint32_t>(term_freqs_.size() - 1);
+    }
+    if (sorted_term_freq_codes_.empty()) {
+        SortTermFreqCodes();
+    }
+    const auto it = std::lower_bound(sorted_term_freq_codes_.begin(), sorted_term_freq_codes_.end(), term_freq,
+                                     [this](uint32_t code, double term_freq) { return term_freqs_[code] < term_freq; });
+    if (it != sorted_term_freq_codes_.end() && term_freqs_[*it] == term_freq) {
+        return *it;
+    }
+    const uint32_t code = static_cast<uint32_t>(term_freqs_.size());
+    term_freqs_.push_back(term_freq);
+    sorted_term_freq_codes_.insert(it, code);
+    return code;
+}
+
+void CompressedPostingList::SortTermFreqCodes() {
+    sorted_term_freq_codes_.resize(term_freqs_.size());
+    std::iota(sorted_term_freq_codes_.begin(), sorted_term_freq_codes_.end(), 0);
+    std::sort(sorted_term_freq_codes_.begin(), sorted_term_freq_codes_.end(), [this](uint32_t lhs, uint32_t rhs) {
+        return term_freqs_[lhs] < term_freqs_[rhs];
+    });
+}
+
+void CompressedPostingList::AppendCode(int document_id, uint32_t term_freq_code) {
+    if (size_ % BLOCK_SIZE == 0) {
+        blocks_.push_back({document_id, document_id, static_cast<uint32_t>(bytes_.size())});
+    }
+    Block& block = blocks_.back();
+    WriteVarint(bytes_, static_cast<uint32_t>(document_id - block.last_document_id));
+    WriteVarint(bytes_, term_freq_code);
+    block.last_document_id = document_id;
+    ++size_;
+}
+
+PostingCursor::PostingCursor(const std::vector<Posting>& postings)
+        : current_(postings.data())
+        , end_(postings.data() + postings.size())
+{}
+
+PostingCursor::PostingCursor(const CompressedPostingList& postings)
+        : compressed_(&postings)
+{
+    block_.reserve(CompressedPostingList::BLOCK_SIZE);
+    LoadBlock(0);
+}
+
+void PostingCursor::Seek(int document_id) {
+    if (compressed_ != nullptr && (IsEnd() || (end_ - 1)->document_id < document_id)) {
+        LoadBlock(compressed_->FindBlock(document_id, next_block_));
+    }
+    current_ = std::lower_bound(current_, end_, document_id, IsBefore);
+}
+
+void PostingCursor::LoadBlock(size_t block_index) {
+    if (block_index >= compressed_->GetBlockCount()) {
+        block_.clear();
+        next_block_ = compressed_->GetBlockCount();
+    } else {
+        compressed_->DecodeBlock(block_index, block_);
+        next_block_ = block_index + 1;
+    }
+    current_ = block_.data();
+    end_ = block_.data() + block_.size();
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// varint: по 7 бит числа в байте, старший бит байта означает, что число продолжается
+void WriteVarint(std::vector<uint8_t>& bytes, uint32_t value);
+// Читает число и сдвигает data за него
+uint32_t ReadVarint(const uint8_t*& data);
+
+struct Posting {
+    int document_id;
+    double term_freq;
+};
+
+// Сжатый список вхождений терма. Вхождения разбиты на блоки по BLOCK_SIZE, в блоке id документов
+// хранятся разностями в varint, частоты — номерами в словаре различных значений частоты терма
+class CompressedPostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    CompressedPostingList() = default;
+    explicit CompressedPostingList(const std::vector<Posting>& postings);
+
+    // document_id должен быть больше всех уже добавленных
+    void Append(int document_id, double term_freq);
+    std::vector<Posting> Decompress() const;
+
+    size_t GetSize() const;
+    bool IsEmpty() const;
+    int GetLastDocumentId() const;
+    size_t GetByteSize() const;
+
+    size_t GetBlockCount() const;
+    // Первый блок, начиная с first_block, в котором может оказаться document_id, либо GetBlockCount()
+    size_t FindBlock(int document_id, size_t first_block = 0) const;
+    void DecodeBlock(size_t block_index, std::vector<Posting>& postings) const;
+    bool Contains(int document_id) const;
+
+private:
+    struct Block {
+        int first_document_id;
+        int last_document_id;
+        uint32_t offset;
+    };
+
+    std::vector<Block> blocks_;
+    std::vector<uint8_t> bytes_;
+    std::vector<double> term_freqs_;
+    // Номера из term_freqs_ по возрастанию значения для поиска номера при добавлении. Строятся при первом
+    // добавлении в список, где различных частот больше MAX_SCANNED_TERM_FREQS: в коротком словаре номер
+    // дешевле найти перебором
+    std::vector<uint32_t> sorted_term_freq_codes_;
+    size_t size_ = 0;
+
+    static constexpr size_t MAX_SCANNED_TERM_FREQS = 16;
+
+    uint32_t GetTermFreqCode(double term_freq);
+    void SortTermFreqCodes();
+    void AppendCode(int document_id, uint32_t term_freq_code);
+};
+
+// Последовательный обход списка вхождений в обычном или сжатом виде; сжатые блоки декодируются по мере обхода
+class PostingCursor {
+public:
+    explicit PostingCursor(const std::vector<Posting>& postings);
+    explicit PostingCursor(const CompressedPostingList& postings);
+
+    PostingCursor(PostingCursor&&) = default;
+    PostingCursor& operator=(PostingCursor&&) = default;
+    PostingCursor(const PostingCursor&) = delete;
+    PostingCursor& operator=(const PostingCursor&) = delete;
+
+    bool IsEnd() const {
+        return current_ == end_;
+    }
+
+    const Posting& operator*() const {
+        return *current_;
+    }
+
+    const Posting* operator->() const {
+        return current_;
+    }
+
+    void Next() {
+        if (++current_ == end_ && compressed_ != nullptr) {
+            LoadBlock(next_block_);
+        }
+    }
+
+    // Переходит к первому вхождению с id документа не меньше document_id
+    void Seek(int document_id);
+
+private:
+    const Posting* current_ = nullptr;
+    const Posting* end_ = nullptr;
+    const CompressedPostingList* compressed_ = nullptr;
+    size_t next_block_ = 0;
+    std::vector<Posting> block_;
+
+    void LoadBlock(size_t block_index);
+};
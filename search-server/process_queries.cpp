@@ -1,25 +1,150 @@
 #include "process_queries.h"
 
+// Окно слотов подбирается так, чтобы на него приходилось около WINDOW_POSTING_BUDGET вхождений группы:
+// вклады окна и накопитель остаются в кэше, пока их обходят все запросы группы
+constexpr size_t WINDOW_POSTING_BUDGET = size_t{1} << 15;
+constexpr size_t MIN_WINDOW_SIZE = 64;
+
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server,
                                                   const std::vector<std::string>& queries) {
+    return ProcessQueries(search_server, queries.begin(), queries.end());
+}
+
+std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server,
+                                                  std::vector<std::string>::const_iterator first,
+                                                  std::vector<std::string>::const_iterator last) {
+    // Разбор идёт последовательно, чтобы ошибка в запросе дошла до вызывающего, а не завершила программу
+    std::vector<SearchServer::Query> queries;
+    queries.reserve(last - first);
+    for (auto it = first; it != last; ++it) {
+        queries.push_back(search_server.ParseQuery(*it));
+    }
     std::vector<std::vector<Document>> result(queries.size());
-    
-    transform(std::execution::par,
-              queries.begin(), queries.end(),
-              result.begin(),
-              [&search_server] (const std::string& query) {
-                  return search_server.FindTopDocuments(query);
-              }
-    );
+    if (!search_server.MayMatchFilter(DocumentFilter{DocumentStatus::ACTUAL, std::nullopt, std::nullopt})) {
+        return result;
+    }
+
+    // Фразы проверяются до параллельной части по той же причине: без позиционного индекса они бросают исключение
+    std::vector<std::optional<DocumentBitmap>> phrase_documents(queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        if (!queries[i].phrases.empty()) {
+            phrase_documents[i] = search_server.FindPhraseDocuments(queries[i].phrases);
+        }
+    }
+
+    // Группы не крупнее доли пакета на поток, чтобы небольшой пакет тоже выполнялся параллельно
+    const size_t worker_count = SearchServer::GetWorkerCount();
+    const size_t group_size = std::max<size_t>(1, (queries.size() + worker_count - 1) / worker_count);
+    std::vector<size_t> group_firsts;
+    for (size_t query_index = 0; query_index < queries.size(); query_index += group_size) {
+        group_firsts.push_back(query_index);
+    }
+    const size_t slot_count = search_server.documents_.ids.size();
+    const double log_document_count = log(search_server.GetDocumentCount());
+    std::for_each(std::execution::par, group_firsts.begin(), group_firsts.end(), [&](size_t group_first) {
+        const size_t query_count = std::min(queries.size() - group_first, group_size);
+        std::vector<InvertedIndex::TermId> term_ids;
+        for (size_t query_index = group_first; query_index < group_first + query_count; ++query_index) {
+            term_ids.insert(term_ids.end(), queries[query_index].plus_terms.begin(), queries[query_index].plus_terms.end());
+        }
+        std::sort(term_ids.begin(), term_ids.end());
+        term_ids.erase(std::unique(term_ids.begin(), term_ids.end()), term_ids.end());
+        std::vector<std::vector<size_t>> query_terms(query_count);
+        for (size_t query_index = 0; query_index < query_count; ++query_index) {
+            for (const InvertedIndex::TermId term_id : queries[group_first + query_index].plus_terms) {
+                query_terms[query_index].push_back(std::lower_bound(term_ids.begin(), term_ids.end(), term_id) - term_ids.begin());
+            }
+        }
+        std::vector<PostingCursor> cursors;
+        std::vector<double> inverse_document_freqs;
+        size_t posting_count = 0;
+        for (const InvertedIndex::TermId term_id : term_ids) {
+            cursors.push_back(search_server.word_to_document_freqs_.GetCursor(term_id));
+            inverse_document_freqs.push_back(search_server.ComputeWordInverseDocumentFreq(term_id, log_document_count));
+            posting_count += search_server.word_to_document_freqs_.GetDocumentFreq(term_id);
+        }
+        std::vector<std::vector<int>> excluded_document_ids(query_count);
+        std::vector<std::vector<int>::const_iterator> excluded_firsts(query_count);
+        for (size_t query_index = 0; query_index < query_count; ++query_index) {
+            excluded_document_ids[query_index] = search_server.CollectDocuments(queries[group_first + query_index].minus_terms);
+            excluded_firsts[query_index] = excluded_document_ids[query_index].cbegin();
+        }
+        const size_t window_size = std::min(std::max<size_t>(1, slot_count), std::max(MIN_WINDOW_SIZE,
+            static_cast<size_t>(static_cast<double>(slot_count) * WINDOW_POSTING_BUDGET / std::max<size_t>(1, posting_count))));
+
+        // Накопитель размером с окно, а не общий накопитель потока: MoveTo обходит его целиком
+        SearchServer::RelevanceAccumulator accumulator;
+        accumulator.Reserve(window_size);
+        std::vector<int> window_slots;
+        std::vector<double> window_scores;
+        std::vector<size_t> term_ends(term_ids.size());
+        std::vector<std::vector<Document>> top_documents(query_count);
+        SearchServer::RelevanceList window_relevances;
+        // Каждое вхождение декодируется и проверяется по статусу один раз на группу. Запрос складывает вклады
+        // своих термов в порядке плюс-слов, а окна идут по возрастанию слотов, поэтому суммы и порядок
+        // подачи в кучу те же, что у FindTopDocuments
+        for (size_t window_first = 0; window_first < slot_count; window_first += window_size) {
+            const int window_last = static_cast<int>(std::min(slot_count, window_first + window_size));
+            window_slots.clear();
+            window_scores.clear();
+            for (size_t term_index = 0; term_index < term_ids.size(); ++term_index) {
+                PostingCursor& cursor = cursors[term_index];
+                for (; !cursor.IsEnd() && cursor->document_id < window_last; cursor.Next()) {
+                    const auto [slot, term_freq] = *cursor;
+                    if (search_server.documents_.statuses[slot] == DocumentStatus::ACTUAL) {
+                        window_slots.push_back(slot - static_cast<int>(window_first));
+                        window_scores.push_back(term_freq * inverse_document_freqs[term_index]);
+                    }
+                }
+                term_ends[term_index] = window_slots.size();
+            }
+            for (size_t query_index = 0; query_index < query_count; ++query_index) {
+                const auto& excluded = excluded_document_ids[query_index];
+                auto& excluded_first = excluded_firsts[query_index];
+                while (excluded_first != excluded.end() && *excluded_first < static_cast<int>(window_first)) {
+                    ++excluded_first;
+                }
+                const auto& query_phrase_documents = phrase_documents[group_first + query_index];
+                for (const size_t term_index : query_terms[query_index]) {
+                    const size_t first = term_index == 0 ? 0 : term_ends[term_index - 1];
+                    if (excluded_first == excluded.end() && !query_phrase_documents) {
+                        for (size_t i = first; i < term_ends[term_index]; ++i) {
+                            accumulator.Add(window_slots[i], window_scores[i]);
+                        }
+                        continue;
+                    }
+                    auto excluded_it = excluded_first;
+                    for (size_t i = first; i < term_ends[term_index]; ++i) {
+                        const int slot = static_cast<int>(window_first) + window_slots[i];
+                        if (SearchServer::ContainsDocument(excluded, excluded_it, slot)
+                            || (query_phrase_documents && !query_phrase_documents->Contains(slot))) {
+                            continue;
+                        }
+                        accumulator.Add(window_slots[i], window_scores[i]);
+                    }
+                }
+                accumulator.MoveTo(window_relevances);
+                for (const auto& [window_slot, relevance] : window_relevances) {
+                    const size_t slot = window_first + window_slot;
+                    SearchServer::PushTopDocument(top_documents[query_index],
+                                                  {search_server.documents_.ids[slot], relevance, search_server.documents_.ratings[slot]},
+                                                  MAX_RESULT_DOCUMENT_COUNT);
+                }
+            }
+        }
+        for (size_t query_index = 0; query_index < query_count; ++query_index) {
+            std::sort_heap(top_documents[query_index].begin(), top_documents[query_index].end(), SearchServer::IsMoreRelevant);
+            result[group_first + query_index] = std::move(top_documents[query_index]);
+        }
+    });
     return result;
 }
 
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server,
                                            const std::vector<std::string>& queries) {
     std::vector<Document> docs;
-    
-    for(const auto& loc_docs : ProcessQueries(search_server, queries)) {
-        docs.insert(docs.end(), loc_docs.begin(), loc_docs.end());
-    }
+    ProcessQueriesJoined(search_server, queries, [&docs](const Document& document) {
+        docs.push_back(document);
+    });
     return docs;    
-}
\ No newline at end of file
+}
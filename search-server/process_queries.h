@@ -5,8 +5,36 @@
 
 #include<numeric>
 
+// Столько запросов потоковый ProcessQueriesJoined обрабатывает за раз
+constexpr size_t QUERY_BATCH_SIZE = 256;
+
+// Результат тот же, что у FindTopDocuments для каждого запроса, но запросы выполняются группами: в группе
+// список вхождений каждого терма обходится один раз, и его вклады раздаются всем запросам группы с этим термом
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server,
                                                   const std::vector<std::string>& queries); 
+std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server,
+                                                  std::vector<std::string>::const_iterator first,
+                                                  std::vector<std::string>::const_iterator last);
 
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server,
-                                           const std::vector<std::string>& queries);
\ No newline at end of file
+                                           const std::vector<std::string>& queries);
+// Документы всех запросов по порядку передаются в consumer. Запросы выполняются пакетами по batch_size,
+// поэтому в памяти одновременно лежат результаты только одного пакета
+template <typename DocumentConsumer>
+void ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries,
+                          DocumentConsumer consumer, size_t batch_size = QUERY_BATCH_SIZE);
+
+template <typename DocumentConsumer>
+void ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries,
+                          DocumentConsumer consumer, size_t batch_size) {
+    batch_size = std::max<size_t>(1, batch_size);
+    for (auto first = queries.begin(); first != queries.end();) {
+        const auto last = first + std::min<size_t>(batch_size, queries.end() - first);
+        for (const auto& documents : ProcessQueries(search_server, first, last)) {
+            for (const Document& document : documents) {
+                consumer(document);
+            }
+        }
+        first = last;
+    }
+}
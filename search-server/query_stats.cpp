@@ -0,0 +1,181 @@
+#include "query_stats.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace {
+
+const char* const KIND_NAMES[] = {"FindTopDocuments", "MatchDocument"};
+const char* const PHASE_NAMES[] = {"total", "parse", "filter", "minus_words", "phrases", "traversal", "merge", "select", "match"};
+const char* const COUNTER_NAMES[] = {"postings_scanned", "minus_word_checks", "documents_scored", "candidates_sorted"};
+
+// MatchDocument не обходит списки вхождений и не ранжирует документы
+bool IsCounterUsed(QueryKind kind, QueryCounter counter) {
+    return kind != QueryKind::MATCH_DOCUMENT || counter == QueryCounter::MINUS_WORD_CHECKS;
+}
+
+size_t GetBucket(uint64_t value) {
+    return value == 0 ? 0 : 64 - __builtin_clzll(value);
+}
+
+void PrintRow(std::ostream& out, const char* name, const HistogramSnapshot& snapshot, const char* unit) {
+    out << "  " << std::left << std::setw(22) << name << std::right
+        << " count " << snapshot.count
+        << ", mean " << snapshot.sum / snapshot.count << unit
+        << ", p50 " << snapshot.GetPercentile(0.5) << unit
+        << ", p99 " << snapshot.GetPercentile(0.99) << unit
+        << ", max " << snapshot.max << unit << '\n';
+}
+
+} // namespace
+
+uint64_t HistogramSnapshot::GetPercentile(double quantile) const {
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(quantile * count + 0.5));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            const uint64_t upper_bound = bucket == 0 ? 0 : (bucket == 64 ? UINT64_MAX : (uint64_t{1} << bucket) - 1);
+            return std::min(upper_bound, max);
+        }
+    }
+    return max;
+}
+
+void Histogram::Record(uint64_t value) {
+    buckets_[GetBucket(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+// Снимок не атомарен целиком: во время параллельной записи счётчики могут разойтись на несколько значений
+HistogramSnapshot Histogram::GetSnapshot() const {
+    HistogramSnapshot snapshot;
+    for (size_t bucket = 0; bucket < HistogramSnapshot::BUCKET_COUNT; ++bucket) {
+        snapshot.buckets[bucket] = buckets_[bucket].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[bucket];
+    }
+    snapshot.sum = sum_.load(std::memory_order_relaxed);
+    snapshot.max = max_.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+void Histogram::Reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+QueryStats& QueryStats::GetInstance() {
+    static QueryStats stats;
+    return stats;
+}
+
+Histogram& QueryStats::GetPhaseHistogram(QueryKind kind, QueryPhase phase) {
+    return phases_[static_cast<size_t>(kind)][static_cast<size_t>(phase)];
+}
+
+Histogram& QueryStats::GetCounterHistogram(QueryKind kind, QueryCounter counter) {
+    return counters_[static_cast<size_t>(kind)][static_cast<size_t>(counter)];
+}
+
+void QueryStats::Print(std::ostream& out) const {
+#ifndef SEARCH_SERVER_INSTRUMENTATION
+    out << "query stats: instrumentation is disabled, build with -DSEARCH_SERVER_INSTRUMENTATION\n";
+#endif
+    for (size_t kind = 0; kind < KIND_COUNT; ++kind) {
+        const HistogramSnapshot total = phases_[kind][static_cast<size_t>(QueryPhase::TOTAL)].GetSnapshot();
+        if (total.count == 0) {
+            continue;
+        }
+        out << KIND_NAMES[kind] << ":\n";
+        for (size_t phase = 0; phase < PHASE_COUNT; ++phase) {
+            const HistogramSnapshot snapshot = phases_[kind][phase].GetSnapshot();
+            if (snapshot.count > 0) {
+                PrintRow(out, PHASE_NAMES[phase], snapshot, " ns");
+            }
+        }
+        for (size_t counter = 0; counter < COUNTER_COUNT; ++counter) {
+            const HistogramSnapshot snapshot = counters_[kind][counter].GetSnapshot();
+            if (snapshot.count > 0) {
+                PrintRow(out, COUNTER_NAMES[counter], snapshot, "");
+            }
+        }
+    }
+}
+
+void QueryStats::Reset() {
+    for (auto& kind_histograms : phases_) {
+        for (Histogram& histogram : kind_histograms) {
+            histogram.Reset();
+        }
+    }
+    for (auto& kind_histograms : counters_) {
+        for (Histogram& histogram : kind_histograms) {
+            histogram.Reset();
+        }
+    }
+}
+
+thread_local QueryTrace* QueryTrace::current_ = nullptr;
+
+QueryTrace::QueryTrace(QueryKind kind)
+        : kind_(kind)
+        , previous_(current_)
+{
+    current_ = this;
+}
+
+// Счётчики записываются и нулевыми: ноль — тоже значение для запроса этого вида
+QueryTrace::~QueryTrace() {
+    current_ = previous_;
+    AddPhaseTime(QueryPhase::TOTAL, Clock::now() - start_time_);
+    QueryStats& stats = QueryStats::GetInstance();
+    for (size_t phase = 0; phase < PHASE_COUNT; ++phase) {
+        if (has_phase_[phase]) {
+            stats.GetPhaseHistogram(kind_, static_cast<QueryPhase>(phase)).Record(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(phase_durations_[phase]).count());
+        }
+    }
+    for (size_t counter = 0; counter < COUNTER_COUNT; ++counter) {
+        if (IsCounterUsed(kind_, static_cast<QueryCounter>(counter))) {
+            stats.GetCounterHistogram(kind_, static_cast<QueryCounter>(counter)).Record(counters_[counter]);
+        }
+    }
+}
+
+QueryTrace* QueryTrace::GetCurrent() {
+    return current_;
+}
+
+void QueryTrace::Count(QueryCounter counter, uint64_t value) {
+    if (current_ != nullptr) {
+        current_->counters_[static_cast<size_t>(counter)] += value;
+    }
+}
+
+void QueryTrace::AddPhaseTime(QueryPhase phase, Clock::duration duration) {
+    phase_durations_[static_cast<size_t>(phase)] += duration;
+    has_phase_[static_cast<size_t>(phase)] = true;
+}
+
+PhaseTimer::PhaseTimer(QueryPhase phase)
+        : trace_(QueryTrace::GetCurrent())
+        , phase_(phase)
+        , start_time_(QueryTrace::Clock::now())
+{}
+
+PhaseTimer::~PhaseTimer() {
+    if (trace_ != nullptr) {
+        trace_->AddPhaseTime(phase_, QueryTrace::Clock::now() - start_time_);
+    }
+}
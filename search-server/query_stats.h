@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Разбивка времени и работы запросов по фазам. Сбор включается сборкой всего проекта
+// с -DSEARCH_SERVER_INSTRUMENTATION; без макроса INSTRUMENT_* раскрываются в пустоту
+// и горячие пути SearchServer компилируются так же, как без этого файла
+
+enum class QueryKind {
+    FIND_TOP_DOCUMENTS,
+    MATCH_DOCUMENT,
+    COUNT
+};
+
+enum class QueryPhase {
+    TOTAL,
+    PARSE,
+    // Выбор документов по DocumentFilter
+    FILTER,
+    // Сбор документов с минус-словами
+    MINUS_WORDS,
+    // Проверка фраз и NEAR/k по позиционному индексу
+    PHRASES,
+    // Обход списков вхождений плюс-слов вместе с проверкой документов
+    TRAVERSAL,
+    // Слияние релевантностей потоков
+    MERGE,
+    // Отбор и сортировка лучших документов
+    SELECT,
+    MATCH,
+    COUNT
+};
+
+enum class QueryCounter {
+    POSTINGS_SCANNED,
+    // Проверки документа на минус-слова; у MatchDocument — проверенные минус-слова
+    MINUS_WORD_CHECKS,
+    DOCUMENTS_SCORED,
+    CANDIDATES_SORTED,
+    COUNT
+};
+
+struct HistogramSnapshot {
+    // В корзине b лежат значения из [2^(b-1), 2^b), в корзине 0 — нули
+    static constexpr size_t BUCKET_COUNT = 65;
+
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    std::array<uint64_t, BUCKET_COUNT> buckets{};
+
+    // Верхняя граница корзины, в которую попадает перцентиль
+    uint64_t GetPercentile(double quantile) const;
+};
+
+// Гистограмма с логарифмическими корзинами. Запись — несколько relaxed-операций над атомарными
+// счётчиками, поэтому потоки пишут в неё без блокировок
+class Histogram {
+public:
+    void Record(uint64_t value);
+    HistogramSnapshot GetSnapshot() const;
+    void Reset();
+
+private:
+    std::array<std::atomic<uint64_t>, HistogramSnapshot::BUCKET_COUNT> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// Общие для процесса гистограммы: время фаз в наносекундах и счётчики, по одному значению на запрос
+class QueryStats {
+public:
+    static QueryStats& GetInstance();
+
+    Histogram& GetPhaseHistogram(QueryKind kind, QueryPhase phase);
+    Histogram& GetCounterHistogram(QueryKind kind, QueryCounter counter);
+
+    void Print(std::ostream& out) const;
+    void Reset();
+
+private:
+    static constexpr size_t KIND_COUNT = static_cast<size_t>(QueryKind::COUNT);
+    static constexpr size_t PHASE_COUNT = static_cast<size_t>(QueryPhase::COUNT);
+    static constexpr size_t COUNTER_COUNT = static_cast<size_t>(QueryCounter::COUNT);
+
+    std::array<std::array<Histogram, PHASE_COUNT>, KIND_COUNT> phases_;
+    std::array<std::array<Histogram, COUNTER_COUNT>, KIND_COUNT> counters_;
+};
+
+// Накопитель одного запроса. Пока он жив, фазы и счётчики, отмеченные в этом потоке, относятся к нему;
+// при уничтожении значения записываются в QueryStats. Потоки параллельного поиска в запрос не пишут:
+// их работа измеряется вызывающим потоком
+class QueryTrace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit QueryTrace(QueryKind kind);
+    ~QueryTrace();
+    QueryTrace(const QueryTrace&) = delete;
+    QueryTrace& operator=(const QueryTrace&) = delete;
+
+    static QueryTrace* GetCurrent();
+    static void Count(QueryCounter counter, uint64_t value);
+
+    void AddPhaseTime(QueryPhase phase, Clock::duration duration);
+
+private:
+    static constexpr size_t PHASE_COUNT = static_cast<size_t>(QueryPhase::COUNT);
+    static constexpr size_t COUNTER_COUNT = static_cast<size_t>(QueryCounter::COUNT);
+
+    static thread_local QueryTrace* current_;
+
+    QueryKind kind_;
+    Clock::time_point start_time_ = Clock::now();
+    QueryTrace* previous_;
+    std::array<Clock::duration, PHASE_COUNT> phase_durations_{};
+    std::array<bool, PHASE_COUNT> has_phase_{};
+    std::array<uint64_t, COUNTER_COUNT> counters_{};
+};
+
+// Время от создания до конца области видимости добавляется к фазе текущего запроса
+class PhaseTimer {
+public:
+    explicit PhaseTimer(QueryPhase phase);
+    ~PhaseTimer();
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    QueryTrace* trace_;
+    QueryPhase phase_;
+    QueryTrace::Clock::time_point start_time_;
+};
+
+#define INSTRUMENT_CONCAT_INTERNAL(X, Y) X##Y
+#define INSTRUMENT_CONCAT(X, Y) INSTRUMENT_CONCAT_INTERNAL(X, Y)
+
+#ifdef SEARCH_SERVER_INSTRUMENTATION
+#define INSTRUMENT_QUERY(kind) QueryTrace INSTRUMENT_CONCAT(query_trace_, __LINE__)(QueryKind::kind)
+#define INSTRUMENT_PHASE(phase) PhaseTimer INSTRUMENT_CONCAT(phase_timer_, __LINE__)(QueryPhase::phase)
+// value вычисляется, только если сбор включён
+#define INSTRUMENT_COUNT(counter, value) QueryTrace::Count(QueryCounter::counter, (value))
+#else
+#define INSTRUMENT_QUERY(kind)
+#define INSTRUMENT_PHASE(phase)
+#define INSTRUMENT_COUNT(counter, value)
+#endif
@@ -0,0 +1,18 @@
+#include "ranking.h"
+
+#include <algorithm>
+#include <cmath>
+
+Bm25Scorer::Bm25Scorer(double k1, double b, size_t document_count, uint64_t total_document_length,
+                       const std::vector<uint32_t>& document_lengths)
+        : k1_(k1)
+        , document_count_(static_cast<double>(document_count))
+        , length_free_norm_(k1 * (1.0 - b))
+        , length_norm_(k1 * b / std::max(1.0, static_cast<double>(total_document_length) / std::max<size_t>(1, document_count)))
+        , document_lengths_(document_lengths)
+{}
+
+double Bm25Scorer::GetTermWeight(double, size_t document_freq) const {
+    const double document_freq_value = static_cast<double>(document_freq);
+    return std::log(1.0 + (document_count_ - document_freq_value + 0.5) / (document_freq_value + 0.5)) * (k1_ + 1.0);
+}
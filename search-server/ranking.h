@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Формулы вклада терма в релевантность документа. Формула — параметр шаблона поиска, поэтому цикл
+// по спискам вхождений компилируется под неё и не ветвится. term_freq — доля слова среди слов документа,
+// term_weight — часть вклада, общая для всех документов терма; её считает GetTermWeight раз на запрос
+
+// TF-IDF: доля слова, умноженная на IDF
+struct TfIdfScorer {
+    double GetTermWeight(double inverse_document_freq, size_t) const {
+        return inverse_document_freq;
+    }
+
+    double Score(double term_weight, int, double term_freq) const {
+        return term_freq * term_weight;
+    }
+
+    // Верхняя граница вклада по всем документам терма
+    double GetMaxScore(double term_weight, double max_term_freq) const {
+        return max_term_freq * term_weight;
+    }
+};
+
+// Okapi BM25: idf * f * (k1 + 1) / (f + k1 * (1 - b + b * length / average_length)), f — число вхождений слова
+class Bm25Scorer {
+public:
+    Bm25Scorer(double k1, double b, size_t document_count, uint64_t total_document_length,
+               const std::vector<uint32_t>& document_lengths);
+
+    // idf = log(1 + (N - df + 0.5) / (df + 0.5)), вместе с множителем k1 + 1
+    double GetTermWeight(double inverse_document_freq, size_t document_freq) const;
+
+    double Score(double term_weight, int slot, double term_freq) const {
+        const double length = document_lengths_[slot];
+        const double count = term_freq * length;
+        return term_weight * count / (count + length_free_norm_ + length_norm_ * length);
+    }
+
+    // Вклад растёт с term_freq и не превосходит term_weight * tf / (tf + k1 * b / average_length)
+    double GetMaxScore(double term_weight, double max_term_freq) const {
+        return term_weight * max_term_freq / (max_term_freq + length_norm_);
+    }
+
+private:
+    double k1_;
+    double document_count_;
+    // k1 * (1 - b) и k1 * b / average_length
+    double length_free_norm_;
+    double length_norm_;
+    // Длины документов по слотам
+    const std::vector<uint32_t>& document_lengths_;
+};
@@ -0,0 +1,141 @@
+#include "remove_duplicates.h"
+
+namespace {
+
+using TermFreqs = std::vector<std::pair<InvertedIndex::TermId, double>>;
+
+class DisjointSets {
+public:
+    explicit DisjointSets(size_t size)
+            : parents_(size)
+    {
+        std::iota(parents_.begin(), parents_.end(), 0);
+    }
+
+    size_t Find(size_t index) {
+        while (parents_[index] != index) {
+            parents_[index] = parents_[parents_[index]];
+            index = parents_[index];
+        }
+        return index;
+    }
+
+    // Корнем становится меньший индекс, то есть документ с меньшим id
+    void Unite(size_t lhs, size_t rhs) {
+        lhs = Find(lhs);
+        rhs = Find(rhs);
+        if (lhs != rhs) {
+            parents_[std::max(lhs, rhs)] = std::min(lhs, rhs);
+        }
+    }
+
+private:
+    std::vector<size_t> parents_;
+};
+
+bool IsSimilar(const TermFreqs& lhs, const TermFreqs& rhs, double min_similarity) {
+    size_t common_count = 0;
+    auto lhs_it = lhs.begin();
+    auto rhs_it = rhs.begin();
+    while (lhs_it != lhs.end() && rhs_it != rhs.end()) {
+        if (lhs_it->first < rhs_it->first) {
+            ++lhs_it;
+        } else if (rhs_it->first < lhs_it->first) {
+            ++rhs_it;
+        } else {
+            ++common_count;
+            ++lhs_it;
+            ++rhs_it;
+        }
+    }
+    const size_t union_count = lhs.size() + rhs.size() - common_count;
+    // Два пустых набора считаются одинаковыми
+    return union_count == 0 || common_count >= min_similarity * union_count - 1e-9;
+}
+
+uint64_t HashBand(const DocumentSignature& signature, size_t band) {
+    constexpr size_t rows = SIGNATURE_SIZE / SIGNATURE_BAND_COUNT;
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t row = band * rows; row < (band + 1) * rows; ++row) {
+        hash = (hash ^ signature[row]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+} // namespace
+
+std::vector<std::vector<int>> FindDuplicateGroups(const SearchServer& search_server, double min_similarity) {
+    std::vector<int> document_ids;
+    std::vector<const DocumentSignature*> signatures;
+    std::vector<const TermFreqs*> document_term_freqs;
+    document_ids.reserve(search_server.GetDocumentCount());
+    signatures.reserve(search_server.GetDocumentCount());
+    document_term_freqs.reserve(search_server.GetDocumentCount());
+    for (const int document_id : search_server) {
+        const int slot = search_server.document_slots_.at(document_id);
+        document_ids.push_back(document_id);
+        signatures.push_back(&search_server.documents_.signatures[slot]);
+        document_term_freqs.push_back(&search_server.documents_.term_freqs[slot]);
+    }
+
+    DisjointSets groups(document_ids.size());
+    std::vector<std::pair<uint64_t, size_t>> band_hashes(document_ids.size());
+    std::vector<size_t> representatives;
+    for (size_t band = 0; band < SIGNATURE_BAND_COUNT; ++band) {
+        for (size_t i = 0; i < document_ids.size(); ++i) {
+            band_hashes[i] = {HashBand(*signatures[i], band), i};
+        }
+        std::sort(std::execution::par, band_hashes.begin(), band_hashes.end());
+
+        // Документ корзины с одинаковым хешем полосы сравнивается только с представителями групп,
+        // уже встреченных в ней, — до первого похожего. С представителем своей группы он не сравнивается.
+        // Не похожий ни на кого документ сам становится представителем
+        for (size_t first = 0; first < band_hashes.size();) {
+            size_t last = first + 1;
+            while (last < band_hashes.size() && band_hashes[last].first == band_hashes[first].first) {
+                ++last;
+            }
+            representatives.clear();
+            for (size_t j = first; j < last; ++j) {
+                const size_t document = band_hashes[j].second;
+                const size_t root = groups.Find(document);
+                const auto representative_it = std::find_if(representatives.begin(), representatives.end(), [&](size_t representative) {
+                    return groups.Find(representative) == root
+                        || IsSimilar(*document_term_freqs[representative], *document_term_freqs[document], min_similarity);
+                });
+                if (representative_it == representatives.end()) {
+                    representatives.push_back(document);
+                } else {
+                    groups.Unite(*representative_it, document);
+                }
+            }
+            first = last;
+        }
+    }
+
+    std::vector<std::vector<int>> duplicate_groups;
+    std::vector<size_t> root_to_group(document_ids.size(), document_ids.size());
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        const size_t root = groups.Find(i);
+        if (root == i) {
+            continue;
+        }
+        if (root_to_group[root] == document_ids.size()) {
+            root_to_group[root] = duplicate_groups.size();
+            duplicate_groups.push_back({document_ids[root]});
+        }
+        duplicate_groups[root_to_group[root]].push_back(document_ids[i]);
+    }
+    std::sort(duplicate_groups.begin(), duplicate_groups.end());
+    return duplicate_groups;
+}
+
+std::vector<int> RemoveDuplicates(SearchServer& search_server, double min_similarity) {
+    std::vector<int> duplicate_ids;
+    for (const auto& group : FindDuplicateGroups(search_server, min_similarity)) {
+        duplicate_ids.insert(duplicate_ids.end(), group.begin() + 1, group.end());
+    }
+    std::sort(duplicate_ids.begin(), duplicate_ids.end());
+    search_server.RemoveDocuments(duplicate_ids);
+    return duplicate_ids;
+}
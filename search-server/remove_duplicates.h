@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "search_server.h"
+
+// Число полос сигнатуры для LSH: документы сравниваются, только если совпали хотя бы в одной полосе
+constexpr size_t SIGNATURE_BAND_COUNT = 4;
+
+// Группы документов, у которых коэффициент Жаккара наборов слов не меньше min_similarity
+// (при 1 — одинаковые наборы слов без учёта порядка и частот). Кандидаты отбираются по полосам
+// MinHash-сигнатур, поэтому время почти линейно по числу документов: точные дубликаты находятся всегда,
+// близкие — с высокой вероятностью. В корзине полосы документ сравнивается лишь с представителями
+// уже найденных в ней групп. Группа — компонента связности по найденным парам,
+// id в группе и сами группы упорядочены по возрастанию
+std::vector<std::vector<int>> FindDuplicateGroups(const SearchServer& search_server, double min_similarity = 1.0);
+
+// Оставляет в каждой группе только документ с наименьшим id; возвращает удалённые id по возрастанию
+std::vector<int> RemoveDuplicates(SearchServer& search_server, double min_similarity = 1.0);
@@ -23,6 +23,10 @@ int RequestQueue::GetNoResultRequests() const {
     return no_results_requests_; 
 } 
 
+void RequestQueue::PrintQueryStats(std::ostream& out) const {
+    QueryStats::GetInstance().Print(out);
+}
+
 void RequestQueue::AddRequest(int results_num) { 
 
     ++current_time_; 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <deque>
+#include <ostream>
 #include <string>
 #include <vector>
 
@@ -18,6 +19,8 @@ public:
     std::vector<Document> AddFindRequest(const std::string& raw_query); 
 
     int GetNoResultRequests() const;
+    // Гистограммы фаз и счётчиков запросов; собираются при сборке с -DSEARCH_SERVER_INSTRUMENTATION
+    void PrintQueryStats(std::ostream& out) const;
 
 private:
     struct QueryResult {
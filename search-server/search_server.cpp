@@ -1,5 +1,39 @@
 #include "search_server.h"
 
+#include <functional>
+
+namespace {
+
+// Расстояние k из оператора NEAR/k; nullopt, если слово не оператор. Слово вроде «NEAR/x»
+// с неразобранным расстоянием — обычное слово запроса, как любое другое слово со слешем
+std::optional<uint32_t> ParseNearDistance(std::string_view word) {
+    constexpr std::string_view prefix = "NEAR/";
+    if (word.substr(0, prefix.size()) != prefix) {
+        return std::nullopt;
+    }
+    uint32_t distance = 0;
+    const char* const end = word.data() + word.size();
+    const auto [parsed_end, error] = std::from_chars(word.data() + prefix.size(), end, distance);
+    if (error != std::errc{} || parsed_end != end || distance == 0) {
+        return std::nullopt;
+    }
+    return distance;
+}
+
+// Поддерживает в heap не больше k наибольших значений; heap.front() — наименьшее из них
+void PushLargest(std::vector<double>& heap, size_t k, double value) {
+    if (heap.size() < k) {
+        heap.push_back(value);
+        std::push_heap(heap.begin(), heap.end(), std::greater<double>());
+    } else if (value > heap.front()) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<double>());
+        heap.back() = value;
+        std::push_heap(heap.begin(), heap.end(), std::greater<double>());
+    }
+}
+
+} // namespace
+
 SearchServer::SearchServer(std::string_view stop_words_text)
         :SearchServer(SplitIntoWords(stop_words_text))
 {}
@@ -12,22 +46,169 @@ void SearchServer::AddDocument(int document_id, std::string_view document, Docum
     if (document_id < 0) {
             throw std::invalid_argument("Отрицательный Id документа");
     }
-    if (documents_.count(document_id) > 0) {
+    if (document_slots_.count(document_id) > 0) {
             throw std::invalid_argument("Документ с таким id уже есть в системе");
     }
-    const auto [it, inserted] = documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status, std::string(document)});
-    const auto words = SplitIntoWordsNoStop(it->second.text);
+    std::vector<std::string_view> words;
+    SplitIntoWordsNoStop(document, words);
     
     const double inv_word_count = 1.0 / words.size();
+    std::map<InvertedIndex::TermId, double> word_freqs;
     for (const std::string_view word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        document_to_word_freqs_[document_id][word] += inv_word_count;
+        word_freqs[word_to_document_freqs_.AddTerm(word)] += inv_word_count;
     }
-    document_ids_.insert(document_id);
+    TermFreqs term_freqs(word_freqs.begin(), word_freqs.end());
+    const int slot = AllocateSlot(document_id);
+    for (const auto& [term_id, term_freq] : term_freqs) {
+        word_to_document_freqs_.AddPosting(term_id, slot, term_freq);
+    }
+    if (positions_) {
+        positions_->AddDocument(slot, ComputeDocumentPositions(document, term_freqs));
+    }
+    documents_.ratings[slot] = ComputeAverageRating(ratings);
+    documents_.statuses[slot] = status;
+    documents_.texts[slot] = document_texts_.Add(document);
+    documents_.signatures[slot] = ComputeDocumentSignature(term_freqs);
+    documents_.lengths[slot] = static_cast<uint32_t>(words.size());
+    documents_.term_freqs[slot] = std::move(term_freqs);
+    AddToFilterCounts(slot);
+    total_document_length_ += words.size();
+    ++generation_;
 }
   
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(std::execution::seq, raw_query,[status](int document_id, DocumentStatus document_status, int rating) {return document_status == status;});
+void SearchServer::AddDocuments(const std::vector<NewDocument>& documents, size_t thread_count) {
+    std::set<int> batch_ids;
+    for (const NewDocument& document : documents) {
+        if (document.id < 0) {
+            throw std::invalid_argument("Отрицательный Id документа");
+        }
+        if (document_slots_.count(document.id) > 0 || !batch_ids.insert(document.id).second) {
+            throw std::invalid_argument("Документ с таким id уже есть в системе");
+        }
+    }
+    if (thread_count == 0) {
+        thread_count = GetWorkerCount();
+    }
+    thread_count = std::max<size_t>(1, std::min(thread_count, documents.size()));
+
+    struct PartialIndex {
+        // Вхождения хранят номер документа в пакете: слоты выдаются, только когда пакет разобран без ошибок
+        std::unordered_map<std::string_view, std::vector<Posting>> word_to_postings;
+        std::vector<std::map<std::string_view, double>> document_word_freqs;
+        std::vector<TermFreqs> document_term_freqs;
+        std::vector<DocumentSignature> document_signatures;
+        std::vector<DocumentPositions> document_positions;
+        std::vector<uint32_t> document_lengths;
+        size_t first_document = 0;
+        std::exception_ptr error;
+    };
+    std::vector<PartialIndex> partial_indexes(thread_count);
+    std::vector<size_t> workers(thread_count);
+    std::iota(workers.begin(), workers.end(), 0);
+    std::for_each(std::execution::par, workers.begin(), workers.end(), [&](size_t worker) {
+        PartialIndex& partial_index = partial_indexes[worker];
+        const size_t first = documents.size() * worker / thread_count;
+        const size_t last = documents.size() * (worker + 1) / thread_count;
+        partial_index.first_document = first;
+        try {
+            partial_index.document_word_freqs.reserve(last - first);
+            std::vector<std::string_view> words;
+            for (size_t i = first; i < last; ++i) {
+                SplitIntoWordsNoStop(documents[i].text, words);
+                const double inv_word_count = 1.0 / words.size();
+                partial_index.document_lengths.push_back(static_cast<uint32_t>(words.size()));
+                auto& word_freqs = partial_index.document_word_freqs.emplace_back();
+                for (const std::string_view word : words) {
+                    word_freqs[word] += inv_word_count;
+                }
+                for (const auto& [word, term_freq] : word_freqs) {
+                    partial_index.word_to_postings[word].push_back({static_cast<int>(i), term_freq});
+                }
+            }
+        } catch (...) {
+            partial_index.error = std::current_exception();
+        }
+    });
+    for (const PartialIndex& partial_index : partial_indexes) {
+        if (partial_index.error) {
+            std::rethrow_exception(partial_index.error);
+        }
+    }
+    std::vector<int> slots(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        slots[i] = AllocateSlot(documents[i].id);
+    }
+
+    // Словарь пополняется последовательно, дальше он только читается
+    std::unordered_map<InvertedIndex::TermId, std::vector<Posting>> term_to_postings;
+    for (PartialIndex& partial_index : partial_indexes) {
+        for (auto& [word, postings] : partial_index.word_to_postings) {
+            auto& term_postings = term_to_postings[word_to_document_freqs_.AddTerm(word)];
+            term_postings.insert(term_postings.end(), postings.begin(), postings.end());
+        }
+        partial_index.word_to_postings.clear();
+    }
+
+    // Частоты слов документов переводятся на id термов, списки вхождений разных термов сливаются параллельно
+    std::for_each(std::execution::par, partial_indexes.begin(), partial_indexes.end(), [this, &documents](PartialIndex& partial_index) {
+        partial_index.document_term_freqs.reserve(partial_index.document_word_freqs.size());
+        partial_index.document_signatures.reserve(partial_index.document_word_freqs.size());
+        for (size_t i = 0; i < partial_index.document_word_freqs.size(); ++i) {
+            const auto& word_freqs = partial_index.document_word_freqs[i];
+            TermFreqs& term_freqs = partial_index.document_term_freqs.emplace_back();
+            term_freqs.reserve(word_freqs.size());
+            for (const auto& [word, term_freq] : word_freqs) {
+                term_freqs.emplace_back(*word_to_document_freqs_.FindTerm(word), term_freq);
+            }
+            std::sort(term_freqs.begin(), term_freqs.end());
+            partial_index.document_signatures.push_back(ComputeDocumentSignature(term_freqs));
+            if (positions_) {
+                partial_index.document_positions.push_back(
+                    ComputeDocumentPositions(documents[partial_index.first_document + i].text, term_freqs));
+            }
+        }
+        partial_index.document_word_freqs.clear();
+    });
+    std::vector<std::pair<InvertedIndex::TermId, std::vector<Posting>>> term_postings(
+        std::make_move_iterator(term_to_postings.begin()), std::make_move_iterator(term_to_postings.end()));
+    std::for_each(std::execution::par, term_postings.begin(), term_postings.end(), [this, &slots](auto& item) {
+        auto& [term_id, postings] = item;
+        for (Posting& posting : postings) {
+            posting.document_id = slots[posting.document_id];
+        }
+        std::sort(postings.begin(), postings.end(), [](const Posting& lhs, const Posting& rhs) {
+            return lhs.document_id < rhs.document_id;
+        });
+        word_to_document_freqs_.AddPostings(term_id, postings);
+    });
+
+    size_t document_index = 0;
+    for (PartialIndex& partial_index : partial_indexes) {
+        for (size_t i = 0; i < partial_index.document_term_freqs.size(); ++i) {
+            const NewDocument& document = documents[document_index];
+            const int slot = slots[document_index++];
+            documents_.ratings[slot] = ComputeAverageRating(document.ratings);
+            documents_.statuses[slot] = document.status;
+            documents_.texts[slot] = document_texts_.Add(document.text);
+            documents_.signatures[slot] = partial_index.document_signatures[i];
+            documents_.lengths[slot] = partial_index.document_lengths[i];
+            documents_.term_freqs[slot] = std::move(partial_index.document_term_freqs[i]);
+            AddToFilterCounts(slot);
+            total_document_length_ += partial_index.document_lengths[i];
+            if (positions_) {
+                positions_->AddDocument(slot, std::move(partial_index.document_positions[i]));
+            }
+        }
+    }
+    ++generation_;
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter, size_t max_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, filter, max_count);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t max_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, status, max_count);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const {
@@ -35,7 +216,11 @@ std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query)
 }
 
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return document_slots_.size();
+}
+
+uint64_t SearchServer::GetGeneration() const {
+    return generation_;
 }
 
 std::set<int>::const_iterator SearchServer::begin() const {
@@ -53,11 +238,14 @@ const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int d
         words_freqs.clear();
     }
     
-    if (document_id < 0 || !documents_.count(document_id)) {
+    const auto slot = FindSlot(document_id);
+    if (!slot) {
         return words_freqs;
     }
 
-    words_freqs = document_to_word_freqs_.at(document_id);
+    for (const auto& [term_id, term_freq] : documents_.term_freqs[*slot]) {
+        words_freqs.emplace(word_to_document_freqs_.GetTerm(term_id), term_freq);
+    }
     return words_freqs;
 }
 
@@ -66,28 +254,35 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const {
-    if (documents_.count(document_id) == 0) {
+    INSTRUMENT_QUERY(MATCH_DOCUMENT);
+    const auto slot = FindSlot(document_id);
+    if (!slot) {
         throw std::invalid_argument("Документ не найден");
     }
 
-    const Query query = ParseQuery(raw_query);
-    const auto status = documents_.at(document_id).status;
+    QueryWords query_words;
+    {
+        INSTRUMENT_PHASE(PARSE);
+        query_words = ParseQueryWords(raw_query);
+    }
+    INSTRUMENT_PHASE(MATCH);
+    const auto status = documents_.statuses[*slot];
+    const TermFreqs& term_freqs = documents_.term_freqs[*slot];
     
-    for (std::string_view word : query.minus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
-            }
-            if (word_to_document_freqs_.at(word).count(document_id)) {
-                return {{}, status};
+    for (const InvertedIndex::TermId term_id : FindTerms(query_words.minus_words)) {
+            INSTRUMENT_COUNT(MINUS_WORD_CHECKS, 1);
+            if (HasTerm(term_freqs, term_id)) {
+                return {std::vector<std::string_view>{}, status};
             }
         }
+    if (!query_words.phrases.empty() && !MatchesPhrases(FindPhraseTerms(query_words.phrases), *slot)) {
+        return {std::vector<std::string_view>{}, status};
+    }
     
     std::vector<std::string_view> matched_words;
-    for (std::string_view word : query.plus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
-            }
-            if (word_to_document_freqs_.at(word).count(document_id)) {
+    for (const std::string_view word : query_words.plus_words) {
+            const auto term_id = word_to_document_freqs_.FindTerm(word);
+            if (term_id && HasTerm(term_freqs, *term_id)) {
                 matched_words.push_back(word);
             }
         }
@@ -95,29 +290,43 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
 }
     
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const {
-    if (documents_.count(document_id) == 0) {
+    INSTRUMENT_QUERY(MATCH_DOCUMENT);
+    const auto slot = FindSlot(document_id);
+    if (!slot) {
         throw std::invalid_argument("Документ не найден");
     }
-    const auto status = documents_.at(document_id).status;
-    const Query query = ParseQuery(raw_query, true);
-    const auto word_checker = 
-        [this, document_id](std::string_view word) {
-            const auto it = word_to_document_freqs_.find(word);
-            return it != word_to_document_freqs_.end() && it->second.count(document_id);
-        };
-    if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), word_checker)) {
-        return {{}, status};
-    }
-    std::vector<std::string_view> matched_words(query.plus_words.size());
-    auto words_end = copy_if(
+    const auto status = documents_.statuses[*slot];
+    QueryWords query_words;
+    {
+        INSTRUMENT_PHASE(PARSE);
+        query_words = ParseQueryWords(raw_query, true);
+    }
+    INSTRUMENT_PHASE(MATCH);
+    const std::vector<InvertedIndex::TermId> minus_terms = FindTerms(query_words.minus_words);
+    // any_of может остановиться раньше, но число проверок в параллельном режиме не определено
+    INSTRUMENT_COUNT(MINUS_WORD_CHECKS, minus_terms.size());
+    const TermFreqs& term_freqs = documents_.term_freqs[*slot];
+    if (std::any_of(std::execution::par, minus_terms.begin(), minus_terms.end(), [&term_freqs](InvertedIndex::TermId term_id) {
+            return HasTerm(term_freqs, term_id);
+        })) {
+        return {std::vector<std::string_view>{}, status};
+    }
+    if (!query_words.phrases.empty() && !MatchesPhrases(FindPhraseTerms(query_words.phrases), *slot)) {
+        return {std::vector<std::string_view>{}, status};
+    }
+    std::vector<std::string_view> matched_words(query_words.plus_words.size());
+    const auto words_end = copy_if(
         std::execution::par,
-        query.plus_words.begin(), query.plus_words.end(),
+        query_words.plus_words.begin(), query_words.plus_words.end(),
         matched_words.begin(),
-        word_checker
+        [this, &term_freqs](std::string_view word) {
+            const auto term_id = word_to_document_freqs_.FindTerm(word);
+            return term_id && HasTerm(term_freqs, *term_id);
+        }
     );
-    std::sort(matched_words.begin(), words_end);
-    words_end = std::unique(matched_words.begin(), words_end);
     matched_words.erase(words_end, matched_words.end());
+    std::sort(matched_words.begin(), matched_words.end());
+    matched_words.erase(std::unique(matched_words.begin(), matched_words.end()), matched_words.end());
     
     return {matched_words, status};
 }
@@ -127,8 +336,81 @@ void SearchServer::RemoveDocument(int document_id) {
     RemoveDocument(std::execution::seq, document_id);
 }
 
+void SearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    std::vector<int> removed_slots;
+    for (const int document_id : document_ids) {
+        if (const auto slot = FindSlot(document_id)) {
+            removed_slots.push_back(*slot);
+        }
+    }
+    std::sort(removed_slots.begin(), removed_slots.end());
+    removed_slots.erase(std::unique(removed_slots.begin(), removed_slots.end()), removed_slots.end());
+    if (removed_slots.empty()) {
+        return;
+    }
+
+    // Документы перебираются по возрастанию слота, поэтому списки у термов сразу упорядочены
+    std::unordered_map<InvertedIndex::TermId, std::vector<int>> term_to_document_ids;
+    for (const int slot : removed_slots) {
+        for (const auto& [term_id, term_freq] : documents_.term_freqs[slot]) {
+            term_to_document_ids[term_id].push_back(slot);
+        }
+    }
+    std::vector<std::pair<InvertedIndex::TermId, std::vector<int>>> term_document_ids(
+        std::make_move_iterator(term_to_document_ids.begin()), std::make_move_iterator(term_to_document_ids.end()));
+    std::for_each(std::execution::par, term_document_ids.begin(), term_document_ids.end(), [this](const auto& item) {
+        word_to_document_freqs_.RemovePostings(item.first, item.second);
+    });
+    for (const auto& [term_id, term_document_ids] : term_document_ids) {
+        word_to_document_freqs_.ReleaseEmptyTerm(term_id);
+    }
+
+    for (const int slot : removed_slots) {
+        ReleaseSlot(slot);
+    }
+    CompactSlotsIfNeeded();
+    ++generation_;
+    if (document_texts_.NeedsCompaction()) {
+        CompactDocumentTexts();
+    }
+}
+
+void SearchServer::SetPostingCompression(bool is_compressed) {
+    word_to_document_freqs_.SetCompression(is_compressed);
+    ++generation_;
+}
+
+PostingStats SearchServer::GetPostingStats() const {
+    return word_to_document_freqs_.GetPostingStats();
+}
+
+void SearchServer::SetPositionIndexing(bool is_enabled) {
+    if (is_enabled == positions_.has_value()) {
+        return;
+    }
+    // Без позиционного индекса запросы с фразами бросают исключение, поэтому закешированные ответы устаревают
+    ++generation_;
+    if (!is_enabled) {
+        positions_.reset();
+        return;
+    }
+    PositionIndex positions;
+    for (const auto& [document_id, slot] : document_slots_) {
+        positions.AddDocument(slot, ComputeDocumentPositions(document_texts_.Get(documents_.texts[slot]), documents_.term_freqs[slot]));
+    }
+    positions_ = std::move(positions);
+}
+
+bool SearchServer::HasPositionIndex() const {
+    return positions_.has_value();
+}
+
+PositionStats SearchServer::GetPositionStats() const {
+    return positions_ ? positions_->GetStats() : PositionStats{0, 0};
+}
+
 bool SearchServer::IsStopWord(std::string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_words_.Contains(word);
 }
 
 bool SearchServer::IsValidWord(std::string_view word) {
@@ -137,17 +419,16 @@ bool SearchServer::IsValidWord(std::string_view word) {
     });
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_view text) const {
-    std::vector<std::string_view> words;
-    for (std::string_view word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument("Некорректный ввод: " + std::string(word));
-        }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
-        }
+void SearchServer::SplitIntoWordsNoStop(std::string_view text, std::vector<std::string_view>& words) const {
+    words.clear();
+    if (const auto invalid_word = SplitIntoWords(text, words)) {
+        throw std::invalid_argument("Некорректный ввод: " + std::string(*invalid_word));
+    }
+    if (!stop_words_.empty()) {
+        words.erase(std::remove_if(words.begin(), words.end(), [this](std::string_view word) {
+            return IsStopWord(word);
+        }), words.end());
     }
-    return words;
 }
 
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
@@ -170,7 +451,9 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
         is_minus = true;
         text = text.substr(1);
     }
-    if (text.empty() || text[0] == '-' || !IsValidWord(text)) {
+    // Управляющие символы уже отсеяны при разбиении запроса на слова, кавычки по краям слова
+    // допустимы только вокруг фразы
+    if (text.empty() || text[0] == '-' || text[0] == '"' || text.back() == '"') {
         throw std::invalid_argument("Некорректный ввод: " + std::string(text));
     }
     return {text,
@@ -179,28 +462,491 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
             };
 }
 
-SearchServer::Query SearchServer::ParseQuery(std::string_view text, bool skip_sort) const {
-    Query query;
-    for (std::string_view word : SplitIntoWords(text)) {
-        const QueryWord query_word = ParseQueryWord(word);
+size_t SearchServer::ParseQueryPhrase(const std::vector<std::string_view>& words, size_t first, QueryWords& query_words) const {
+    QueryPhrase phrase{{}, {}, 0};
+    uint32_t offset = 0;
+    size_t last = first;
+    std::string_view word = words[first].substr(1);
+    while (true) {
+        const bool is_closing = !word.empty() && word.back() == '"';
+        if (is_closing) {
+            word.remove_suffix(1);
+        }
+        if (!word.empty()) {
+            const QueryWord query_word = ParseQueryWord(word);
+            if (query_word.is_minus) {
+                throw std::invalid_argument("Минус-слово внутри фразы: " + std::string(word));
+            }
+            // Стоп-слово не проверяется, но занимает место во фразе
+            if (!query_word.is_stop) {
+                query_words.plus_words.push_back(query_word.data);
+                phrase.words.push_back(query_word.data);
+                phrase.offsets.push_back(offset);
+            }
+            ++offset;
+        }
+        if (is_closing) {
+            break;
+        }
+        if (++last == words.size()) {
+            throw std::invalid_argument("Незакрытая кавычка в запросе");
+        }
+        word = words[last];
+    }
+    if (offset == 0) {
+        throw std::invalid_argument("Пустая фраза в запросе");
+    }
+    if (!phrase.words.empty()) {
+        query_words.phrases.push_back(std::move(phrase));
+    }
+    return last;
+}
+
+SearchServer::QueryWords SearchServer::ParseQueryWords(std::string_view text, bool skip_sort) const {
+    QueryWords query_words;
+    std::vector<std::string_view> words;
+    if (const auto invalid_word = SplitIntoWords(text, words)) {
+        throw std::invalid_argument("Некорректный ввод: " + std::string(*invalid_word));
+    }
+    for (size_t i = 0; i < words.size(); ++i) {
+        if (words[i][0] == '"') {
+            i = ParseQueryPhrase(words, i, query_words);
+            continue;
+        }
+        // Слова вокруг NEAR/k разбираются как обычные плюс-слова, оператор лишь добавляет условие на них
+        if (const auto max_distance = ParseNearDistance(words[i])) {
+            if (i == 0 || i + 1 == words.size() || ParseNearDistance(words[i + 1])) {
+                throw std::invalid_argument("NEAR/k должен стоять между двумя словами");
+            }
+            const QueryWord lhs = ParseQueryWord(words[i - 1]);
+            const QueryWord rhs = ParseQueryWord(words[i + 1]);
+            if (lhs.is_minus || rhs.is_minus) {
+                throw std::invalid_argument("NEAR/k связывает только плюс-слова");
+            }
+            if (!lhs.is_stop && !rhs.is_stop) {
+                query_words.phrases.push_back({{lhs.data, rhs.data}, {0, 0}, *max_distance});
+            }
+            continue;
+        }
+        const QueryWord query_word = ParseQueryWord(words[i]);
         if (!query_word.is_stop) {
             if (query_word.is_minus) {
-                query.minus_words.push_back(query_word.data);
+                query_words.minus_words.push_back(query_word.data);
             } else {
-                query.plus_words.push_back(query_word.data);
+                query_words.plus_words.push_back(query_word.data);
             }
         }
     }
         
+    // Сортировка по строкам сохраняет прежний порядок суммирования релевантности и вывода слов
     if (!skip_sort) {
-        for (auto* words : {&query.plus_words, &query.minus_words}) {
+        for (auto* words : {&query_words.plus_words, &query_words.minus_words}) {
             std::sort(words->begin(), words->end());
             words->erase(std::unique(words->begin(), words->end()),words->end());
         }
     }
+    return query_words;
+}
+
+SearchServer::Query SearchServer::MakeQuery(const QueryWords& query_words) const {
+    Query query{FindTerms(query_words.plus_words), FindTerms(query_words.minus_words), {}, FindPhraseTerms(query_words.phrases)};
+    query.inverse_document_freqs.reserve(query.plus_terms.size());
+    const double log_document_count = log(GetDocumentCount());
+    for (const InvertedIndex::TermId term_id : query.plus_terms) {
+        query.inverse_document_freqs.push_back(ComputeWordInverseDocumentFreq(term_id, log_document_count));
+    }
     return query;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(std::string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+std::vector<SearchServer::PhraseTerms> SearchServer::FindPhraseTerms(const std::vector<QueryPhrase>& phrases) const {
+    std::vector<PhraseTerms> phrase_terms;
+    phrase_terms.reserve(phrases.size());
+    for (const QueryPhrase& phrase : phrases) {
+        PhraseTerms& terms = phrase_terms.emplace_back();
+        terms.offsets = phrase.offsets;
+        terms.max_distance = phrase.max_distance;
+        for (const std::string_view word : phrase.words) {
+            const auto term_id = word_to_document_freqs_.FindTerm(word);
+            if (!term_id) {
+                terms.term_ids.clear();
+                break;
+            }
+            terms.term_ids.push_back(*term_id);
+        }
+    }
+    return phrase_terms;
+}
+
+SearchServer::Query SearchServer::ParseQuery(std::string_view text, bool skip_sort) const {
+    INSTRUMENT_PHASE(PARSE);
+    return MakeQuery(ParseQueryWords(text, skip_sort));
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(InvertedIndex::TermId term_id, double log_document_count) const {
+    return log_document_count - word_to_document_freqs_.GetLogDocumentFreq(term_id);
+}
+
+size_t SearchServer::GetWorkerCount() {
+    static const size_t worker_count = std::max(1u, std::thread::hardware_concurrency());
+    return worker_count;
+}
+
+SearchServer::RelevanceAccumulator& SearchServer::GetThreadRelevanceAccumulator() {
+    static thread_local RelevanceAccumulator accumulator;
+    return accumulator;
+}
+
+void SearchServer::RelevanceAccumulator::Reserve(size_t slot_count) {
+    if (relevances_.size() < slot_count) {
+        relevances_.resize(slot_count, 0.0);
+        is_scored_.resize(slot_count, 0);
+        // Лишняя ячейка принимает запись слота, который уже есть в списке, когда затронуты все слоты
+        scored_slots_.resize(slot_count + 1);
+    }
+}
+
+double SearchServer::RelevanceAccumulator::FindKthRelevance(size_t k, std::vector<double>& buffer) const {
+    buffer.clear();
+    for (size_t i = 0; i < scored_count_; ++i) {
+        PushLargest(buffer, k, relevances_[scored_slots_[i]]);
+    }
+    return buffer.front();
+}
+
+// Слоты одного терма уже упорядочены. Сортировка остальных стоит порядка k log k сравнений с промахами
+// предсказаний, поэтому уже от 1/64 затронутых слотов дешевле собрать их заново проходом по флагам без ветвлений
+void SearchServer::RelevanceAccumulator::MoveTo(RelevanceList& result) {
+    const auto scored_end = scored_slots_.begin() + scored_count_;
+    if (!std::is_sorted(scored_slots_.begin(), scored_end)) {
+        if (scored_count_ * 64 < is_scored_.size()) {
+            std::sort(scored_slots_.begin(), scored_end);
+        } else {
+            size_t size = 0;
+            for (size_t slot = 0; slot < is_scored_.size(); ++slot) {
+                scored_slots_[size] = static_cast<int>(slot);
+                size += is_scored_[slot];
+            }
+        }
+    }
+    result.resize(scored_count_);
+    for (size_t i = 0; i < scored_count_; ++i) {
+        const int slot = scored_slots_[i];
+        result[i] = {slot, relevances_[slot]};
+        relevances_[slot] = 0.0;
+        is_scored_[slot] = 0;
+    }
+    scored_count_ = 0;
+}
+
+void SearchServer::MergeRelevances(RelevanceList& target, const RelevanceList& source) {
+    RelevanceList merged;
+    merged.reserve(target.size() + source.size());
+    auto target_it = target.begin();
+    auto source_it = source.begin();
+    while (target_it != target.end() && source_it != source.end()) {
+        if (target_it->first < source_it->first) {
+            merged.push_back(*target_it++);
+        } else if (source_it->first < target_it->first) {
+            merged.push_back(*source_it++);
+        } else {
+            merged.emplace_back(target_it->first, target_it->second + source_it->second);
+            ++target_it;
+            ++source_it;
+        }
+    }
+    merged.insert(merged.end(), target_it, target.end());
+    merged.insert(merged.end(), source_it, source.end());
+    target.swap(merged);
+}
+
+double SearchServer::FindKthRelevance(const RelevanceList& relevances, size_t k, std::vector<double>& buffer) {
+    buffer.clear();
+    for (const auto& [slot, relevance] : relevances) {
+        PushLargest(buffer, k, relevance);
+    }
+    return buffer.front();
+}
+
+bool SearchServer::IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < DEVIATION) {
+        if (lhs.rating == rhs.rating) {
+            return lhs.id < rhs.id;
+        }
+        return lhs.rating > rhs.rating;
+    } else {
+        return lhs.relevance > rhs.relevance;
+    }
+}
+
+// Куча ограниченного размера: в вершине наименее релевантный из отобранных документов
+void SearchServer::PushTopDocument(std::vector<Document>& top_documents, const Document& document, size_t max_count) {
+    if (top_documents.size() < max_count) {
+        top_documents.push_back(document);
+        std::push_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+    } else if (max_count > 0 && IsMoreRelevant(document, top_documents.front())) {
+        std::pop_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+        top_documents.back() = document;
+        std::push_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+    }
+}
+
+std::vector<Document> SearchServer::SelectTopDocuments(const RelevanceList& document_to_relevance, size_t max_count) const {
+    INSTRUMENT_PHASE(SELECT);
+    INSTRUMENT_COUNT(CANDIDATES_SORTED, document_to_relevance.size());
+    std::vector<Document> top_documents;
+    top_documents.reserve(std::min(max_count, document_to_relevance.size()));
+    for (const auto& [slot, relevance] : document_to_relevance) {
+        PushTopDocument(top_documents, {documents_.ids[slot], relevance, documents_.ratings[slot]}, max_count);
+    }
+    std::sort_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+    return top_documents;
+}
+
+std::vector<InvertedIndex::TermId> SearchServer::FindTerms(const std::vector<std::string_view>& words) const {
+    std::vector<InvertedIndex::TermId> term_ids;
+    term_ids.reserve(words.size());
+    for (const std::string_view word : words) {
+        if (const auto term_id = word_to_document_freqs_.FindTerm(word)) {
+            term_ids.push_back(*term_id);
+        }
+    }
+    return term_ids;
+}
+
+bool SearchServer::HasTerm(const TermFreqs& term_freqs, InvertedIndex::TermId term_id) {
+    return FindTermIndex(term_freqs, term_id).has_value();
+}
+
+std::optional<size_t> SearchServer::FindTermIndex(const TermFreqs& term_freqs, InvertedIndex::TermId term_id) {
+    const auto it = std::lower_bound(term_freqs.begin(), term_freqs.end(), term_id, [](const auto& item, InvertedIndex::TermId id) {
+        return item.first < id;
+    });
+    if (it == term_freqs.end() || it->first != term_id) {
+        return std::nullopt;
+    }
+    return it - term_freqs.begin();
+}
+
+std::vector<int> SearchServer::CollectDocuments(const std::vector<InvertedIndex::TermId>& term_ids) const {
+    INSTRUMENT_PHASE(MINUS_WORDS);
+    std::vector<int> document_ids;
+    std::vector<int> term_document_ids;
+    std::vector<int> buffer;
+    for (const InvertedIndex::TermId term_id : term_ids) {
+        term_document_ids.clear();
+        for (auto cursor = word_to_document_freqs_.GetCursor(term_id); !cursor.IsEnd(); cursor.Next()) {
+            term_document_ids.push_back(cursor->document_id);
+        }
+        buffer.clear();
+        std::set_union(document_ids.begin(), document_ids.end(),
+                       term_document_ids.begin(), term_document_ids.end(),
+                       std::back_inserter(buffer));
+        document_ids.swap(buffer);
+    }
+    return document_ids;
+}
+
+size_t SearchServer::CountPostings(const std::vector<InvertedIndex::TermId>& term_ids) const {
+    size_t posting_count = 0;
+    for (const InvertedIndex::TermId term_id : term_ids) {
+        posting_count += word_to_document_freqs_.GetDocumentFreq(term_id);
+    }
+    return posting_count;
+}
+
+bool SearchServer::ContainsDocument(const std::vector<int>& document_ids, std::vector<int>::const_iterator& it, int document_id) {
+    while (it != document_ids.end() && *it < document_id) {
+        ++it;
+    }
+    return it != document_ids.end() && *it == document_id;
+}
+
+void SearchServer::DocumentColumns::Resize(size_t size) {
+    ids.resize(size, -1);
+    ratings.resize(size);
+    statuses.resize(size);
+    texts.resize(size);
+    signatures.resize(size);
+    lengths.resize(size);
+    term_freqs.resize(size);
+}
+
+void SearchServer::DocumentColumns::MoveSlot(size_t from, size_t to) {
+    ids[to] = ids[from];
+    ratings[to] = ratings[from];
+    statuses[to] = statuses[from];
+    texts[to] = texts[from];
+    signatures[to] = signatures[from];
+    lengths[to] = lengths[from];
+    term_freqs[to] = std::move(term_freqs[from]);
+}
+
+std::optional<int> SearchServer::FindSlot(int document_id) const {
+    const auto slot_it = document_slots_.find(document_id);
+    if (slot_it == document_slots_.end()) {
+        return std::nullopt;
+    }
+    return slot_it->second;
+}
+
+// Слоты выдаются по возрастанию: вхождения нового документа дописываются в конец списков,
+// и сжатый список не пересобирается. Освободившиеся слоты возвращает CompactSlotsIfNeeded
+int SearchServer::AllocateSlot(int document_id) {
+    const int slot = static_cast<int>(documents_.ids.size());
+    documents_.Resize(documents_.ids.size() + 1);
+    documents_.ids[slot] = document_id;
+    document_slots_.emplace(document_id, slot);
+    document_ids_.insert(document_id);
+    return slot;
+}
+
+void SearchServer::ReleaseSlot(int slot) {
+    const int document_id = documents_.ids[slot];
+    RemoveFromFilterCounts(slot);
+    document_texts_.Release(documents_.texts[slot]);
+    total_document_length_ -= documents_.lengths[slot];
+    if (positions_) {
+        positions_->RemoveDocument(slot);
+    }
+    TermFreqs().swap(documents_.term_freqs[slot]);
+    documents_.ids[slot] = -1;
+    document_slots_.erase(document_id);
+    document_ids_.erase(document_id);
+    ++released_slot_count_;
+}
+
+// Занятые слоты сдвигаются к началу без смены порядка, поэтому списки вхождений остаются упорядоченными.
+// Перенумерация обходит весь индекс, но случается не чаще, чем раз на столько удалений, сколько документов осталось
+void SearchServer::CompactSlotsIfNeeded() {
+    if (released_slot_count_ <= document_slots_.size()) {
+        return;
+    }
+    std::vector<int> new_slots(documents_.ids.size(), -1);
+    size_t slot_count = 0;
+    for (size_t slot = 0; slot < documents_.ids.size(); ++slot) {
+        if (documents_.ids[slot] == -1) {
+            continue;
+        }
+        if (slot != slot_count) {
+            documents_.MoveSlot(slot, slot_count);
+        }
+        document_slots_[documents_.ids[slot_count]] = static_cast<int>(slot_count);
+        new_slots[slot] = static_cast<int>(slot_count++);
+    }
+    documents_.Resize(slot_count);
+    word_to_document_freqs_.RenumberDocuments(new_slots);
+    if (positions_) {
+        positions_->RenumberSlots(new_slots);
+    }
+    released_slot_count_ = 0;
+}
+
+void SearchServer::AddToFilterCounts(int slot) {
+    ++status_counts_[documents_.statuses[slot]];
+    ++rating_counts_[documents_.ratings[slot]];
+}
+
+void SearchServer::RemoveFromFilterCounts(int slot) {
+    const auto status_it = status_counts_.find(documents_.statuses[slot]);
+    if (--status_it->second == 0) {
+        status_counts_.erase(status_it);
+    }
+    const auto rating_it = rating_counts_.find(documents_.ratings[slot]);
+    if (--rating_it->second == 0) {
+        rating_counts_.erase(rating_it);
+    }
+}
+
+bool SearchServer::MayMatchFilter(const DocumentFilter& filter) const {
+    INSTRUMENT_PHASE(FILTER);
+    if (filter.status && status_counts_.count(*filter.status) == 0) {
+        return false;
+    }
+    if (!filter.min_rating && !filter.max_rating) {
+        return true;
+    }
+    if (filter.min_rating && filter.max_rating && *filter.min_rating > *filter.max_rating) {
+        return false;
+    }
+    const auto first = filter.min_rating ? rating_counts_.lower_bound(*filter.min_rating) : rating_counts_.begin();
+    return first != rating_counts_.end() && (!filter.max_rating || first->first <= *filter.max_rating);
+}
+
+// Тексты оставшихся документов переносятся в новое хранилище, блоки старого освобождаются целиком
+void SearchServer::CompactDocumentTexts() {
+    StringArena document_texts;
+    for (const auto& [document_id, slot] : document_slots_) {
+        documents_.texts[slot] = document_texts.Add(document_texts_.Get(documents_.texts[slot]));
+    }
+    document_texts_ = std::move(document_texts);
+}
+
+DocumentPositions SearchServer::ComputeDocumentPositions(std::string_view text, const TermFreqs& term_freqs) const {
+    std::vector<std::string_view> words;
+    SplitIntoWords(text, words);
+    std::vector<std::vector<uint32_t>> term_positions(term_freqs.size());
+    for (uint32_t position = 0; position < words.size(); ++position) {
+        if (!IsStopWord(words[position])) {
+            const InvertedIndex::TermId term_id = *word_to_document_freqs_.FindTerm(words[position]);
+            term_positions[*FindTermIndex(term_freqs, term_id)].push_back(position);
+        }
+    }
+    return DocumentPositions(term_positions);
+}
+
+bool SearchServer::MatchesPhrase(const PhraseTerms& phrase, int slot, std::vector<std::vector<uint32_t>>& term_positions) const {
+    if (phrase.term_ids.empty()) {
+        return false;
+    }
+    const TermFreqs& term_freqs = documents_.term_freqs[slot];
+    const DocumentPositions& document_positions = positions_->GetDocumentPositions(slot);
+    term_positions.resize(phrase.term_ids.size());
+    for (size_t i = 0; i < phrase.term_ids.size(); ++i) {
+        const auto term_index = FindTermIndex(term_freqs, phrase.term_ids[i]);
+        if (!term_index) {
+            return false;
+        }
+        document_positions.Decode(*term_index, term_positions[i]);
+    }
+    return MatchPositions(term_positions, phrase.offsets, phrase.max_distance);
+}
+
+bool SearchServer::MatchesPhrases(const std::vector<PhraseTerms>& phrases, int slot) const {
+    if (!positions_) {
+        throw std::invalid_argument("Фразы и NEAR/k требуют позиционного индекса");
+    }
+    std::vector<std::vector<uint32_t>> term_positions;
+    return std::all_of(phrases.begin(), phrases.end(), [&](const PhraseTerms& phrase) {
+        return MatchesPhrase(phrase, slot, term_positions);
+    });
+}
+
+DocumentBitmap SearchServer::FindPhraseDocuments(const std::vector<PhraseTerms>& phrases) const {
+    INSTRUMENT_PHASE(PHRASES);
+    if (!positions_) {
+        throw std::invalid_argument("Фразы и NEAR/k требуют позиционного индекса");
+    }
+    std::optional<DocumentBitmap> phrase_documents;
+    std::vector<std::vector<uint32_t>> term_positions;
+    for (const PhraseTerms& phrase : phrases) {
+        DocumentBitmap matched_documents;
+        if (!phrase.term_ids.empty()) {
+            const InvertedIndex::TermId rarest_term = *std::min_element(phrase.term_ids.begin(), phrase.term_ids.end(),
+                [this](InvertedIndex::TermId lhs, InvertedIndex::TermId rhs) {
+                    return word_to_document_freqs_.GetDocumentFreq(lhs) < word_to_document_freqs_.GetDocumentFreq(rhs);
+                });
+            for (auto cursor = word_to_document_freqs_.GetCursor(rarest_term); !cursor.IsEnd(); cursor.Next()) {
+                const int slot = cursor->document_id;
+                if ((!phrase_documents || phrase_documents->Contains(slot))
+                    && MatchesPhrase(phrase, slot, term_positions)) {
+                    matched_documents.Add(slot);
+                }
+            }
+        }
+        phrase_documents = std::move(matched_documents);
+        if (phrase_documents->IsEmpty()) {
+            break;
+        }
+    }
+    return std::move(*phrase_documents);
 }
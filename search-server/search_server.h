@@ -1,24 +1,83 @@
 #pragma once
 
 #include <algorithm>
+#include <charconv>
 #include <cmath>
+#include <cstdint>
+#include <exception>
 #include <execution>
+#include <iterator>
+#include <limits>
 #include <list>
 #include <map>
+#include <numeric>
+#include <optional>
 #include <set>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "document.h"
+#include "document_bitmap.h"
+#include "document_signature.h"
+#include "inverted_index.h"
+#include "position_index.h"
+#include "query_stats.h"
+#include "ranking.h"
+#include "string_arena.h"
+#include "stop_word_set.h"
 #include "string_processing.h"
-#include "concurrent_map.h"
 
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 constexpr double DEVIATION = 1e-6;
 
+namespace search_policy {
+// Поиск с досрочным отсечением документов (MaxScore): результат тот же, что у полного перебора.
+// Выигрывает, когда в запросе есть и редкие, и частые слова: списки частых просматриваются только для лучших кандидатов
+struct MaxScorePolicy {};
+inline constexpr MaxScorePolicy max_score;
+
+// Ранжирование по BM25 вместо TF-IDF; execution — политика самого поиска: seq, par или max_score.
+// Например, FindTopDocuments(search_policy::Bm25{std::execution::par, 1.2, 0.75}, query)
+template <typename ExecutionPolicy>
+struct Bm25 {
+    ExecutionPolicy execution;
+    double k1 = 1.2;
+    double b = 0.75;
+};
+
+template <typename ExecutionPolicy>
+Bm25(ExecutionPolicy) -> Bm25<ExecutionPolicy>;
+template <typename ExecutionPolicy>
+Bm25(ExecutionPolicy, double, double) -> Bm25<ExecutionPolicy>;
+
+template <typename Policy>
+inline constexpr bool is_bm25_v = false;
+template <typename ExecutionPolicy>
+inline constexpr bool is_bm25_v<Bm25<ExecutionPolicy>> = true;
+} // namespace search_policy
+
+struct NewDocument {
+    int id;
+    std::string_view text;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
+
+// Декларативный фильтр поиска: проверяется по столбцам статусов и рейтингов без вызова пользовательского предиката.
+// Незаданное поле не ограничивает выборку, границы рейтинга включаются
+struct DocumentFilter {
+    std::optional<DocumentStatus> status;
+    std::optional<int> min_rating;
+    std::optional<int> max_rating;
+};
+
 class SearchServer {
 public:
     template <typename StringContainer>
@@ -26,28 +85,53 @@ public:
     
     explicit SearchServer(const std::string& stop_words);
     explicit SearchServer(std::string_view stop_word_text);
+    // Стоп-слова, проверенные и разложенные по хеш-таблице при компиляции
+    template <size_t N>
+    explicit SearchServer(const StaticStopWordSet<N>& stop_words);
     
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    // Пакетное добавление: документы разбираются в thread_count потоков (0 — по числу ядер),
+    // частичные индексы потоков сливаются в общий за один проход. Результат тот же, что у
+    // последовательных вызовов AddDocument; при ошибке в любом документе индекс не меняется
+    void AddDocuments(const std::vector<NewDocument>& documents, size_t thread_count = 0);
 
+    // max_count ограничивает число возвращаемых документов; для страницы N размера page_size достаточно (N + 1) * page_size.
+    // "Фраза в кавычках" требует слов подряд, «слово NEAR/k слово» — слов не дальше k друг от друга;
+    // их слова участвуют в релевантности как обычные плюс-слова. Такие запросы требуют позиционного индекса.
+    // «NEAR/x» без положительного числа x — обычное слово
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
             
     template <typename DocumentPredicate, typename Policy>
-    std::vector<Document> FindTopDocuments(const Policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(const Policy& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    // Фильтр, которому не соответствует ни один документ, отсекается до обхода списков вхождений
     template <typename Policy>
-    std::vector<Document> FindTopDocuments(const Policy& policy, std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const Policy& policy, std::string_view raw_query, const DocumentFilter& filter,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <typename Policy>
+    std::vector<Document> FindTopDocuments(const Policy& policy, std::string_view raw_query, DocumentStatus status,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
     template <typename Policy>
     std::vector<Document> FindTopDocuments(const Policy& policy, std::string_view raw_query) const;
 
     int GetDocumentCount() const;
+    // Увеличивается при каждом изменении набора документов или способа хранения индекса
+    uint64_t GetGeneration() const;
     
     std::set<int>::const_iterator begin() const;
     std::set<int>::const_iterator end() const;
 
     const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
     
+    // Слова результата указывают в raw_query, а не в словарь индекса: они остаются верными после
+    // удаления документов и уплотнения словаря, пока жив текст запроса
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const;
@@ -56,23 +140,68 @@ public:
       
     template <typename Policy>
     void RemoveDocument(Policy& policy, int document_id);
+    // Пакетное удаление: вхождения группируются по термам, и список каждого терма пересобирается
+    // один раз, разные термы — параллельно. Отсутствующие id пропускаются
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    // Хранить списки вхождений в сжатом виде: меньше памяти, но медленнее поиск и изменения индекса
+    void SetPostingCompression(bool is_compressed);
+    PostingStats GetPostingStats() const;
+
+    // Включение строит позиции слов по сохранённым текстам документов, выключение освобождает их
+    void SetPositionIndexing(bool is_enabled);
+    bool HasPositionIndex() const;
+    PositionStats GetPositionStats() const;
            
 private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-        std::string text;
+    friend class IndexSnapshot;
+    friend class CachedSearchServer;
+    friend class SegmentedSearchServer;
+    friend std::vector<std::vector<int>> FindDuplicateGroups(const SearchServer& search_server, double min_similarity);
+    friend std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server,
+                                                             std::vector<std::string>::const_iterator first,
+                                                             std::vector<std::string>::const_iterator last);
+
+    // Частоты слов документа, упорядоченные по id терма
+    using TermFreqs = std::vector<std::pair<InvertedIndex::TermId, double>>;
+
+    // Данные документов по плотным внутренним номерам (слотам), столбец на поле. Слоты выдаются
+    // при добавлении документа, освободившиеся используются повторно; в свободном слоте id равен -1.
+    // Списки вхождений, карты фильтров и позиции хранят слоты, а не внешние id
+    struct DocumentColumns {
+        std::vector<int> ids;
+        std::vector<int> ratings;
+        std::vector<DocumentStatus> statuses;
+        std::vector<StringArena::StringRef> texts;
+        std::vector<DocumentSignature> signatures;
+        // Число слов без стоп-слов; нужно BM25
+        std::vector<uint32_t> lengths;
+        std::vector<TermFreqs> term_freqs;
+
+        void Resize(size_t size);
+        void MoveSlot(size_t from, size_t to);
     };
 
-    std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
-    std::map<int, DocumentData> documents_;
+    StopWordSet stop_words_;
+    InvertedIndex word_to_document_freqs_;
+    DocumentColumns documents_;
+    // Слот документа по внешнему id
+    std::unordered_map<int, int> document_slots_;
+    // Слоты удалённых документов; заново они выдаются только после CompactSlots
+    size_t released_slot_count_ = 0;
     std::set<int> document_ids_;
+    StringArena document_texts_;
+    // Число документов с каждым статусом и рейтингом
+    std::map<DocumentStatus, int> status_counts_;
+    std::map<int, int> rating_counts_;
+    std::optional<PositionIndex> positions_;
+    uint64_t total_document_length_ = 0;
+    uint64_t generation_ = 0;
     
     bool IsStopWord(std::string_view word) const;
     static bool IsValidWord(std::string_view word);
-    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
+    // Заменяет содержимое words словами text без стоп-слов, чтобы буфер служил многим документам
+    void SplitIntoWordsNoStop(std::string_view text, std::vector<std::string_view>& words) const;
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
     struct QueryWord {
@@ -83,17 +212,148 @@ private:
 
     QueryWord ParseQueryWord(std::string_view text) const;
 
-    struct Query {
+    // Фраза или пара слов NEAR/k: слова без стоп-слов и их места от начала фразы
+    struct QueryPhrase {
+        std::vector<std::string_view> words;
+        std::vector<uint32_t> offsets;
+        uint32_t max_distance;
+    };
+
+    struct QueryWords {
         std::vector<std::string_view> plus_words;
         std::vector<std::string_view> minus_words;
+        std::vector<QueryPhrase> phrases;
     };
 
+    struct PhraseTerms {
+        // Пусто, если слова фразы нет в словаре: тогда ей не соответствует ни один документ
+        std::vector<InvertedIndex::TermId> term_ids;
+        std::vector<uint32_t> offsets;
+        uint32_t max_distance;
+    };
+
+    // Термы запроса; слова, которых нет в словаре, на результат не влияют и отбрасываются при разборе.
+    // IDF плюс-слов хранятся вместе с запросом, чтобы сегментированный индекс мог подставить общие для всех сегментов
+    struct Query {
+        std::vector<InvertedIndex::TermId> plus_terms;
+        std::vector<InvertedIndex::TermId> minus_terms;
+        std::vector<double> inverse_document_freqs;
+        std::vector<PhraseTerms> phrases;
+    };
+
+    // Разбирает фразу, открытую кавычкой в words[first], и возвращает индекс слова с закрывающей кавычкой
+    size_t ParseQueryPhrase(const std::vector<std::string_view>& words, size_t first, QueryWords& query_words) const;
+    QueryWords ParseQueryWords(std::string_view text, bool skip_sort = false) const;
+    Query MakeQuery(const QueryWords& query_words) const;
+    std::vector<PhraseTerms> FindPhraseTerms(const std::vector<QueryPhrase>& phrases) const;
     Query ParseQuery(std::string_view text, bool skip_sort = false) const;
 
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
+    // log(N / df) в виде log(N) - log(df): log(df) хранится в индексе, log(N) считается раз на запрос
+    double ComputeWordInverseDocumentFreq(InvertedIndex::TermId term_id, double log_document_count) const;
+
+    std::vector<InvertedIndex::TermId> FindTerms(const std::vector<std::string_view>& words) const;
+    static bool HasTerm(const TermFreqs& term_freqs, InvertedIndex::TermId term_id);
+    // Номер терма среди термов документа
+    static std::optional<size_t> FindTermIndex(const TermFreqs& term_freqs, InvertedIndex::TermId term_id);
+    // Объединение списков документов термов, упорядоченное по id
+    std::vector<int> CollectDocuments(const std::vector<InvertedIndex::TermId>& term_ids) const;
+    // Суммарная длина списков вхождений термов
+    size_t CountPostings(const std::vector<InvertedIndex::TermId>& term_ids) const;
+    // Проверка при обходе документов по возрастанию слота: it только продвигается вперёд
+    static bool ContainsDocument(const std::vector<int>& document_ids, std::vector<int>::const_iterator& it, int document_id);
+    void CompactDocumentTexts();
+    std::optional<int> FindSlot(int document_id) const;
+    int AllocateSlot(int document_id);
+    // Освобождает слот вместе с текстом, позициями и счётчиками фильтров; списки вхождений уже очищены
+    void ReleaseSlot(int slot);
+    // Когда освобождённых слотов больше, чем занятых, документы переносятся в начальные слоты
+    void CompactSlotsIfNeeded();
+    void AddToFilterCounts(int slot);
+    void RemoveFromFilterCounts(int slot);
+    // false, если фильтру заведомо не соответствует ни один документ
+    bool MayMatchFilter(const DocumentFilter& filter) const;
+
+    // Термы документа уже в словаре, текст проверен при разборе
+    DocumentPositions ComputeDocumentPositions(std::string_view text, const TermFreqs& term_freqs) const;
+    bool MatchesPhrase(const PhraseTerms& phrase, int slot, std::vector<std::vector<uint32_t>>& term_positions) const;
+    bool MatchesPhrases(const std::vector<PhraseTerms>& phrases, int slot) const;
+    // Документы, в которых есть все фразы запроса: обходится самый короткий список вхождений фразы,
+    // позиции читаются только у документов, где есть все её слова
+    DocumentBitmap FindPhraseDocuments(const std::vector<PhraseTerms>& phrases) const;
+
+    // Релевантности документов, упорядоченные по id; у каждого потока поиска свой список
+    using RelevanceList = std::vector<std::pair<int, double>>;
+
+    // Суммы релевантности по слотам в плотном массиве и список слотов, получивших хоть один вклад.
+    // У каждого потока свой накопитель на все запросы: после выдачи результата обнуляются только затронутые ячейки
+    class RelevanceAccumulator {
+    public:
+        void Reserve(size_t slot_count);
+
+        // Без ветвлений: слот записывается в список всегда, но остаётся в нём, только если встретился впервые.
+        // Незатронутые суммы равны нулю, а 0.0 + score == score, поэтому порядок сложения тот же, что при слиянии списков.
+        // Возвращает новую сумму слота
+        double Add(int slot, double score) {
+            relevances_[slot] += score;
+            scored_slots_[scored_count_] = slot;
+            scored_count_ += is_scored_[slot] ^ 1;
+            is_scored_[slot] = 1;
+            return relevances_[slot];
+        }
 
-    template <typename DocumentPredicate, class Policy>
-    std::vector<Document> FindAllDocuments(const Policy policy, const Query& query, DocumentPredicate document_predicate) const;
+        // Прибавляет вклад, только если слот уже получил вклад раньше
+        void AddToScored(int slot, double score) {
+            relevances_[slot] += is_scored_[slot] ? score : 0.0;
+        }
+
+        size_t GetScoredCount() const {
+            return scored_count_;
+        }
+
+        // k-я по убыванию накопленная сумма, 0 < k <= GetScoredCount(); buffer — рабочая память
+        double FindKthRelevance(size_t k, std::vector<double>& buffer) const;
+        // Заменяет содержимое result накопленными релевантностями по возрастанию слота и очищает накопитель
+        void MoveTo(RelevanceList& result);
+
+    private:
+        std::vector<double> relevances_;
+        std::vector<uint8_t> is_scored_;
+        // Первые scored_count_ элементов — затронутые слоты в порядке первого вклада
+        std::vector<int> scored_slots_;
+        size_t scored_count_ = 0;
+    };
+
+    static size_t GetWorkerCount();
+    static RelevanceAccumulator& GetThreadRelevanceAccumulator();
+    static void MergeRelevances(RelevanceList& target, const RelevanceList& source);
+    static double FindKthRelevance(const RelevanceList& relevances, size_t k, std::vector<double>& buffer);
+
+    // DocumentChecker принимает только id документа: проверка по фильтру не требует его данных
+    template <typename DocumentChecker, typename Policy>
+    std::vector<Document> SearchDocuments(const Policy& policy, const Query& query, DocumentChecker document_checker, size_t max_count) const;
+    // Политика BM25 выбирает Bm25Scorer и передаёт поиск вложенной политике выполнения
+    template <typename DocumentChecker, typename Policy, typename Scorer = TfIdfScorer>
+    std::vector<Document> RankDocuments(const Policy& policy, const Query& query, DocumentChecker document_checker, size_t max_count,
+                                        const Scorer& scorer = Scorer{}) const;
+
+    template <typename Policy>
+    std::vector<Document> SearchFilteredDocuments(const Policy& policy, const Query& query, const DocumentFilter& filter, size_t max_count,
+                                                  const DocumentBitmap* excluded_documents = nullptr) const;
+    // Для каждого сочетания заданных полей фильтра свой предикат, чтобы не ветвиться на каждом вхождении
+    template <typename DocumentChecker, typename Policy>
+    std::vector<Document> SearchDocumentsWithFilter(const Policy& policy, const Query& query, const DocumentFilter& filter, size_t max_count,
+                                                    DocumentChecker document_checker) const;
+
+    template <typename DocumentChecker, class Policy, typename Scorer>
+    RelevanceList FindAllDocuments(const Policy policy, const Query& query, DocumentChecker document_checker, const Scorer& scorer) const;
+
+    template <typename DocumentChecker, typename Scorer>
+    std::vector<Document> FindTopDocumentsMaxScore(const Query& query, DocumentChecker document_checker, size_t max_count,
+                                                   const Scorer& scorer) const;
+
+    static bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+    static void PushTopDocument(std::vector<Document>& top_documents, const Document& document, size_t max_count);
+    std::vector<Document> SelectTopDocuments(const RelevanceList& document_to_relevance, size_t max_count) const;
 };
 
 template <typename StringContainer>
@@ -105,32 +365,35 @@ SearchServer::SearchServer(const StringContainer& stop_words)
     }
 }
 
+template <size_t N>
+SearchServer::SearchServer(const StaticStopWordSet<N>& stop_words)
+        : stop_words_(stop_words)
+{}
+
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t max_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_count);
 }
     
 template <typename DocumentPredicate, typename Policy>
-std::vector<Document> SearchServer::FindTopDocuments(const Policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
+std::vector<Document> SearchServer::FindTopDocuments(const Policy& policy, std::string_view raw_query, DocumentPredicate document_predicate, size_t max_count) const {
+    INSTRUMENT_QUERY(FIND_TOP_DOCUMENTS);
     const auto query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+    const auto document_checker = [this, &document_predicate](int slot) {
+        return document_predicate(documents_.ids[slot], documents_.statuses[slot], documents_.ratings[slot]);
+    };
+    return SearchDocuments(policy, query, document_checker, max_count);
+}
 
-    sort(policy,matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < DEVIATION) {
-            return lhs.rating > rhs.rating;
-        } else {
-            return lhs.relevance > rhs.relevance;
-        }
-    });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-    return matched_documents;
+template <typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(const Policy& policy, std::string_view raw_query, const DocumentFilter& filter, size_t max_count) const {
+    INSTRUMENT_QUERY(FIND_TOP_DOCUMENTS);
+    return SearchFilteredDocuments(policy, ParseQuery(raw_query), filter, max_count);
 }
 
 template <typename Policy>
-std::vector<Document> SearchServer::FindTopDocuments(const Policy& policy, std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query,[status](int document_id, DocumentStatus document_status, int rating) {return document_status == status;});
+std::vector<Document> SearchServer::FindTopDocuments(const Policy& policy, std::string_view raw_query, DocumentStatus status, size_t max_count) const {
+    return FindTopDocuments(policy, raw_query, DocumentFilter{status, std::nullopt, std::nullopt}, max_count);
 }
 
 template <typename Policy>
@@ -138,63 +401,305 @@ std::vector<Document> SearchServer::FindTopDocuments(const Policy& policy, std::
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-template <typename DocumentPredicate, typename Policy>
-std::vector<Document> SearchServer::FindAllDocuments(const Policy policy, const Query& query, DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance(8);
-
-    const auto func = [&](std::string_view word) 
-        { 
-            if (word_to_document_freqs_.count(word) != 0) 
-            { 
-                const double inverse_document_freq = ComputeWordInverseDocumentFreq(word); 
-                for (const auto& [document_id, term_freq] : (*word_to_document_freqs_.find(word)).second) 
-                { 
-                    const auto& document_data = documents_.at(document_id); 
-                    if (document_predicate(document_id, document_data.status, document_data.rating) &&  
-                        std::all_of(query.minus_words.begin(), query.minus_words.end(), [&](std::string_view minus_word) 
-                            { 
-                                return (document_to_word_freqs_.at(document_id).count(minus_word) == 0); 
-                            })
-                        ) 
-                    { 
-                        document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq; 
-                    } 
+template <typename Policy>
+std::vector<Document> SearchServer::SearchFilteredDocuments(const Policy& policy, const Query& query, const DocumentFilter& filter, size_t max_count,
+                                                            const DocumentBitmap* excluded_documents) const {
+    if (!MayMatchFilter(filter)) {
+        return {};
+    }
+    if (excluded_documents == nullptr) {
+        return SearchDocumentsWithFilter(policy, query, filter, max_count, [](int) {
+            return true;
+        });
+    }
+    return SearchDocumentsWithFilter(policy, query, filter, max_count, [excluded_documents](int slot) {
+        return !excluded_documents->Contains(slot);
+    });
+}
+
+template <typename DocumentChecker, typename Policy>
+std::vector<Document> SearchServer::SearchDocumentsWithFilter(const Policy& policy, const Query& query, const DocumentFilter& filter, size_t max_count,
+                                                              DocumentChecker document_checker) const {
+    // Предикаты хранят указатели на столбцы, а не this: на каждом вхождении на одно зависимое чтение меньше
+    const auto has_status = [statuses = documents_.statuses.data(), status = filter.status.value_or(DocumentStatus::ACTUAL)](int slot) {
+        return statuses[slot] == status;
+    };
+    // Диапазон проверяется одним беззнаковым сравнением; MayMatchFilter уже убедился, что min_rating <= max_rating
+    const auto min_rating = static_cast<unsigned>(filter.min_rating.value_or(std::numeric_limits<int>::min()));
+    const auto max_rating = static_cast<unsigned>(filter.max_rating.value_or(std::numeric_limits<int>::max()));
+    const auto has_rating = [ratings = documents_.ratings.data(), min_rating, rating_range = max_rating - min_rating](int slot) {
+        return static_cast<unsigned>(ratings[slot]) - min_rating <= rating_range;
+    };
+    if (!filter.min_rating && !filter.max_rating) {
+        if (!filter.status) {
+            return SearchDocuments(policy, query, document_checker, max_count);
+        }
+        return SearchDocuments(policy, query, [has_status, document_checker](int slot) {
+            return has_status(slot) && document_checker(slot);
+        }, max_count);
+    }
+    if (!filter.status) {
+        return SearchDocuments(policy, query, [has_rating, document_checker](int slot) {
+            return has_rating(slot) && document_checker(slot);
+        }, max_count);
+    }
+    return SearchDocuments(policy, query, [has_status, has_rating, document_checker](int slot) {
+        return has_rating(slot) && has_status(slot) && document_checker(slot);
+    }, max_count);
+}
+
+template <typename DocumentChecker, typename Policy>
+std::vector<Document> SearchServer::SearchDocuments(const Policy& policy, const Query& query, DocumentChecker document_checker, size_t max_count) const {
+    if (query.phrases.empty()) {
+        return RankDocuments(policy, query, document_checker, max_count);
+    }
+    const DocumentBitmap phrase_documents = FindPhraseDocuments(query.phrases);
+    if (phrase_documents.IsEmpty()) {
+        return {};
+    }
+    return RankDocuments(policy, query, [&phrase_documents, &document_checker](int slot) {
+        return phrase_documents.Contains(slot) && document_checker(slot);
+    }, max_count);
+}
+
+template <typename DocumentChecker, typename Policy, typename Scorer>
+std::vector<Document> SearchServer::RankDocuments(const Policy& policy, const Query& query, DocumentChecker document_checker, size_t max_count,
+                                                  const Scorer& scorer) const {
+    if constexpr (search_policy::is_bm25_v<Policy>) {
+        return RankDocuments(policy.execution, query, document_checker, max_count,
+                             Bm25Scorer(policy.k1, policy.b, GetDocumentCount(), total_document_length_, documents_.lengths));
+    } else if constexpr (std::is_same_v<Policy, search_policy::MaxScorePolicy>) {
+        return FindTopDocumentsMaxScore(query, document_checker, max_count, scorer);
+    } else {
+        return SelectTopDocuments(FindAllDocuments(policy, query, document_checker, scorer), max_count);
+    }
+}
+
+template <typename DocumentChecker, typename Policy, typename Scorer>
+SearchServer::RelevanceList SearchServer::FindAllDocuments(const Policy policy, const Query& query, DocumentChecker document_checker,
+                                                           const Scorer& scorer) const {
+    const size_t worker_count = std::is_same_v<Policy, std::execution::sequenced_policy>
+                                ? 1
+                                : std::max<size_t>(1, std::min(GetWorkerCount(), query.plus_terms.size()));
+    std::vector<RelevanceList> worker_relevances(worker_count);
+    const std::vector<int> excluded_document_ids = CollectDocuments(query.minus_terms);
+
+    std::vector<double> term_weights(query.plus_terms.size());
+    for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+        term_weights[i] = scorer.GetTermWeight(query.inverse_document_freqs[i], word_to_document_freqs_.GetDocumentFreq(query.plus_terms[i]));
+    }
+
+    const auto score_term = [&](InvertedIndex::TermId term_id, double term_weight, RelevanceAccumulator& accumulator)
+        {
+            auto excluded_it = excluded_document_ids.begin();
+            for (auto cursor = word_to_document_freqs_.GetCursor(term_id); !cursor.IsEnd(); cursor.Next())
+            {
+                const auto [slot, term_freq] = *cursor;
+                if (ContainsDocument(excluded_document_ids, excluded_it, slot)) {
+                    continue;
+                }
+                if (!document_checker(slot))
+                {
+                    continue;
                 }
+                accumulator.Add(slot, scorer.Score(term_weight, slot, term_freq));
             }
         };
 
-    std::for_each(policy, query.plus_words.begin(), query.plus_words.end(), func);
+    std::vector<size_t> workers(worker_count);
+    std::iota(workers.begin(), workers.end(), 0);
+    {
+        INSTRUMENT_PHASE(TRAVERSAL);
+        std::for_each(policy, workers.begin(), workers.end(), [&](size_t worker) {
+            const size_t first = query.plus_terms.size() * worker / worker_count;
+            const size_t last = query.plus_terms.size() * (worker + 1) / worker_count;
+            // Накопитель потока отдаётся до выхода из задачи, поэтому задача, которую поток возьмёт следом, найдёт его пустым
+            RelevanceAccumulator& accumulator = GetThreadRelevanceAccumulator();
+            accumulator.Reserve(documents_.ids.size());
+            for (size_t i = first; i < last; ++i) {
+                score_term(query.plus_terms[i], term_weights[i], accumulator);
+            }
+            accumulator.MoveTo(worker_relevances[worker]);
+        });
+    }
+    INSTRUMENT_COUNT(POSTINGS_SCANNED, CountPostings(query.plus_terms));
+    INSTRUMENT_COUNT(MINUS_WORD_CHECKS, excluded_document_ids.empty() ? 0 : CountPostings(query.plus_terms));
 
-    std::map<int, double> m_doc_to_relevance = document_to_relevance.BuildOrdinaryMap();
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : m_doc_to_relevance) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+    INSTRUMENT_PHASE(MERGE);
+    RelevanceList& document_to_relevance = worker_relevances.front();
+    for (size_t worker = 1; worker < worker_count; ++worker) {
+        MergeRelevances(document_to_relevance, worker_relevances[worker]);
     }
-    return matched_documents;
+    INSTRUMENT_COUNT(DOCUMENTS_SCORED, document_to_relevance.size());
+    return std::move(document_to_relevance);
+}
+
+template <typename DocumentChecker, typename Scorer>
+std::vector<Document> SearchServer::FindTopDocumentsMaxScore(const Query& query, DocumentChecker document_checker, size_t max_count,
+                                                             const Scorer& scorer) const {
+    if (max_count == 0) {
+        return {};
+    }
+    INSTRUMENT_PHASE(TRAVERSAL);
+    struct TermBound {
+        InvertedIndex::TermId term_id;
+        size_t document_freq;
+        double term_weight;
+        double max_score;
+    };
+
+    std::vector<double> term_weights(query.plus_terms.size(), 0.0);
+    std::vector<TermBound> terms;
+    for (size_t word_index = 0; word_index < query.plus_terms.size(); ++word_index) {
+        const InvertedIndex::TermId term_id = query.plus_terms[word_index];
+        const size_t document_freq = word_to_document_freqs_.GetDocumentFreq(term_id);
+        if (document_freq == 0) {
+            continue;
+        }
+        term_weights[word_index] = scorer.GetTermWeight(query.inverse_document_freqs[word_index], document_freq);
+        terms.push_back({term_id, document_freq, term_weights[word_index],
+                         scorer.GetMaxScore(term_weights[word_index], word_to_document_freqs_.GetMaxTermFreq(term_id))});
+    }
+    // Списки обходятся от большей верхней границы вклада к меньшей; remaining_max_scores[i] — сумма границ термов i и дальше
+    std::sort(terms.begin(), terms.end(), [](const TermBound& lhs, const TermBound& rhs) {
+        return lhs.max_score > rhs.max_score;
+    });
+    std::vector<double> remaining_max_scores(terms.size() + 1, 0.0);
+    std::vector<size_t> remaining_document_freqs(terms.size() + 1, 0);
+    for (size_t i = terms.size(); i-- > 0;) {
+        remaining_max_scores[i] = remaining_max_scores[i + 1] + terms[i].max_score;
+        remaining_document_freqs[i] = remaining_document_freqs[i + 1] + terms[i].document_freq;
+    }
+
+    // Вклады неотрицательны, поэтому k-я по величине частичная сумма не больше итоговой релевантности k-го документа.
+    // Документ, которому остальные термы не добавят столько, чтобы превысить её больше чем на DEVIATION, в ответ не попадёт
+    const std::vector<int> excluded_document_ids = CollectDocuments(query.minus_terms);
+    double threshold = -std::numeric_limits<double>::infinity();
+    std::vector<double> buffer;
+    RelevanceAccumulator& accumulator = GetThreadRelevanceAccumulator();
+    accumulator.Reserve(documents_.ids.size());
+    size_t first_optional = terms.size();
+    // Верхние границы k-й частичной суммы: наибольшая частичная сумма и последнее найденное
+    // значение k-й суммы плюс границы пройденных с тех пор термов
+    double max_relevance = 0.0;
+    double kth_relevance = 0.0;
+    size_t checked_terms = 0;
+    for (size_t i = 0; i < terms.size(); ++i) {
+        auto excluded_it = excluded_document_ids.begin();
+        for (auto cursor = word_to_document_freqs_.GetCursor(terms[i].term_id); !cursor.IsEnd(); cursor.Next()) {
+            const auto [slot, term_freq] = *cursor;
+            if (!ContainsDocument(excluded_document_ids, excluded_it, slot) && document_checker(slot)) {
+                max_relevance = std::max(max_relevance, accumulator.Add(slot, scorer.Score(terms[i].term_weight, slot, term_freq)));
+            }
+        }
+        INSTRUMENT_COUNT(POSTINGS_SCANNED, terms[i].document_freq);
+        INSTRUMENT_COUNT(MINUS_WORD_CHECKS, excluded_document_ids.empty() ? 0 : terms[i].document_freq);
+        // Поиск k-й суммы стоит прохода по всем кандидатам, поэтому делается, только когда по границе отсечение возможно
+        const double kth_relevance_bound = std::min(max_relevance,
+                                                    kth_relevance + remaining_max_scores[checked_terms] - remaining_max_scores[i + 1]);
+        if (i + 1 < terms.size() && remaining_max_scores[i + 1] < kth_relevance_bound - DEVIATION
+            && accumulator.GetScoredCount() >= max_count) {
+            kth_relevance = accumulator.FindKthRelevance(max_count, buffer);
+            checked_terms = i + 1;
+            threshold = kth_relevance - DEVIATION;
+            if (remaining_max_scores[i + 1] < threshold) {
+                first_optional = i + 1;
+                break;
+            }
+        }
+    }
+
+    // Остальные списки только уточняют суммы уже найденных кандидатов. Пока кандидатов не намного меньше,
+    // чем вхождений в оставшихся списках, списки проходятся целиком; дальше кандидаты, которые уже
+    // не наберут порог, отбрасываются, а списки проходятся вместе с ними
+    RelevanceList candidates;
+    bool is_accumulating = true;
+    for (size_t i = first_optional; i < terms.size(); ++i) {
+        auto cursor = word_to_document_freqs_.GetCursor(terms[i].term_id);
+        if (is_accumulating && accumulator.GetScoredCount() * 4 > remaining_document_freqs[i]) {
+            for (; !cursor.IsEnd(); cursor.Next()) {
+                const auto [slot, term_freq] = *cursor;
+                accumulator.AddToScored(slot, scorer.Score(terms[i].term_weight, slot, term_freq));
+            }
+            INSTRUMENT_COUNT(POSTINGS_SCANNED, terms[i].document_freq);
+            continue;
+        }
+        if (is_accumulating) {
+            accumulator.MoveTo(candidates);
+            is_accumulating = false;
+        }
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](const auto& candidate) {
+            return candidate.second + remaining_max_scores[i] < threshold;
+        }), candidates.end());
+        // Немногих кандидатов дешевле искать в списке, иначе список и кандидаты проходятся слиянием
+        const bool is_seeking = candidates.size() * 16 < terms[i].document_freq;
+        for (auto& [slot, relevance] : candidates) {
+            if (is_seeking) {
+                cursor.Seek(slot);
+            } else {
+                while (!cursor.IsEnd() && cursor->document_id < slot) {
+                    cursor.Next();
+                }
+            }
+            if (cursor.IsEnd()) {
+                break;
+            }
+            if (cursor->document_id == slot) {
+                relevance += scorer.Score(terms[i].term_weight, slot, cursor->term_freq);
+            }
+        }
+        INSTRUMENT_COUNT(POSTINGS_SCANNED, is_seeking ? candidates.size() : terms[i].document_freq);
+    }
+    if (is_accumulating) {
+        accumulator.MoveTo(candidates);
+    }
+    if (candidates.size() >= max_count) {
+        threshold = std::max(threshold, FindKthRelevance(candidates, max_count, buffer) - DEVIATION);
+    }
+
+    // Суммы оставшихся кандидатов пересчитываются в порядке слов запроса, как при полном переборе
+    std::vector<Document> top_documents;
+    for (const auto& [slot, partial_relevance] : candidates) {
+        if (partial_relevance < threshold) {
+            continue;
+        }
+        INSTRUMENT_COUNT(DOCUMENTS_SCORED, 1);
+        const TermFreqs& term_freqs = documents_.term_freqs[slot];
+        double relevance = 0.0;
+        for (size_t word_index = 0; word_index < query.plus_terms.size(); ++word_index) {
+            if (const auto term_index = FindTermIndex(term_freqs, query.plus_terms[word_index])) {
+                relevance += scorer.Score(term_weights[word_index], slot, term_freqs[*term_index].second);
+            }
+        }
+        PushTopDocument(top_documents, {documents_.ids[slot], relevance, documents_.ratings[slot]}, max_count);
+        INSTRUMENT_COUNT(CANDIDATES_SORTED, 1);
+    }
+    std::sort_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+    return top_documents;
 }
 
 template <typename Policy>
 void SearchServer::RemoveDocument(Policy& policy, int document_id) {
-    if (document_to_word_freqs_.count(document_id) == 0) {
+    const auto slot = FindSlot(document_id);
+    if (!slot) {
         return;
     }
-
-    document_ids_.erase(document_id);
+    ++generation_;
     
-    const auto& word_freqs = document_to_word_freqs_.at(document_id);
-    std::vector<std::string_view> words(word_freqs.size());
-    transform(
-        policy,
-        word_freqs.begin(), word_freqs.end(),
-        words.begin(),
-        [](const auto& item) { return item.first; }
-    );
+    const TermFreqs& word_freqs = documents_.term_freqs[*slot];
     for_each(
         policy,
-        words.begin(), words.end(),
-        [this, document_id](std::string_view word) {
-            word_to_document_freqs_.at(word).erase(document_id);
+        word_freqs.begin(), word_freqs.end(),
+        [this, slot = *slot](const auto& item) {
+            word_to_document_freqs_.RemovePosting(item.first, slot);
         });
-    
-    documents_.erase(document_id);
+    // Словарь меняется только здесь, после параллельного удаления вхождений
+    for (const auto& [term_id, term_freq] : word_freqs) {
+        word_to_document_freqs_.ReleaseEmptyTerm(term_id);
+    }
+    ReleaseSlot(*slot);
+    CompactSlotsIfNeeded();
+    if (document_texts_.NeedsCompaction()) {
+        CompactDocumentTexts();
+    }
 }
@@ -0,0 +1,249 @@
+#include "segmented_search_server.h"
+
+SegmentedSearchServer::SegmentedSearchServer(std::string_view stop_words_text, size_t buffer_size)
+        : empty_index_(stop_words_text)
+        , buffer_size_(std::max<size_t>(1, buffer_size))
+        , write_buffer_(empty_index_)
+{}
+
+SegmentedSearchServer::SegmentedSearchServer(SearchServer search_server, size_t buffer_size)
+        : empty_index_(MakeEmptyIndex(search_server))
+        , buffer_size_(std::max<size_t>(1, buffer_size))
+        , write_buffer_(empty_index_)
+{
+    if (search_server.GetDocumentCount() > 0) {
+        segments_.push_back(MakeSegment(std::move(search_server)));
+    }
+}
+
+SegmentedSearchServer::SegmentedSearchServer(const SegmentedSearchServer& other)
+        : empty_index_(other.empty_index_)
+        , buffer_size_(other.buffer_size_)
+        , write_buffer_(other.write_buffer_)
+{
+    segments_.reserve(other.segments_.size());
+    for (const auto& segment : other.segments_) {
+        segments_.push_back(std::make_shared<Segment>(*segment));
+    }
+}
+
+void SegmentedSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    if (FindSegment(document_id) != nullptr) {
+        throw std::invalid_argument("Документ с таким id уже есть в системе");
+    }
+    write_buffer_.AddDocument(document_id, document, status, ratings);
+    if (static_cast<size_t>(write_buffer_.GetDocumentCount()) >= buffer_size_) {
+        SealWriteBuffer();
+    }
+    RunMergePolicy();
+}
+
+void SegmentedSearchServer::RemoveDocument(int document_id) {
+    if (const auto segment = FindSegment(document_id)) {
+        DeleteFromSegment(*segment, document_id);
+        const bool is_merging = merge_task_ && std::count(merge_task_->sources.begin(), merge_task_->sources.end(), segment) > 0;
+        if (segment->live_document_count == 0 && !is_merging) {
+            segments_.erase(std::find(segments_.begin(), segments_.end(), segment));
+        }
+    } else {
+        write_buffer_.RemoveDocument(document_id);
+    }
+    RunMergePolicy();
+}
+
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter, size_t max_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, filter, max_count);
+}
+
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t max_count) const {
+    return FindTopDocuments(raw_query, DocumentFilter{status, std::nullopt, std::nullopt}, max_count);
+}
+
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SegmentedSearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+    if (const auto segment = FindSegment(document_id)) {
+        return segment->index->MatchDocument(raw_query, document_id);
+    }
+    return write_buffer_.MatchDocument(raw_query, document_id);
+}
+
+int SegmentedSearchServer::GetDocumentCount() const {
+    size_t document_count = write_buffer_.GetDocumentCount();
+    for (const auto& segment : segments_) {
+        document_count += segment->live_document_count;
+    }
+    return static_cast<int>(document_count);
+}
+
+size_t SegmentedSearchServer::GetSegmentCount() const {
+    return segments_.size();
+}
+
+void SegmentedSearchServer::WaitForMerges() {
+    while (merge_task_) {
+        merge_task_->result.wait();
+        RunMergePolicy();
+    }
+}
+
+void SegmentedSearchServer::Flush() {
+    if (write_buffer_.GetDocumentCount() > 0) {
+        SealWriteBuffer();
+        RunMergePolicy();
+    }
+}
+
+std::shared_ptr<SegmentedSearchServer::Segment> SegmentedSearchServer::FindSegment(int document_id) const {
+    for (const auto& segment : segments_) {
+        const auto slot = segment->index->FindSlot(document_id);
+        if (slot && !segment->deleted_documents.Contains(*slot)) {
+            return segment;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<SegmentedSearchServer::Segment> SegmentedSearchServer::MakeSegment(SearchServer index) {
+    const size_t document_count = index.GetDocumentCount();
+    return std::make_shared<Segment>(Segment{std::make_shared<const SearchServer>(std::move(index)), {}, {}, document_count});
+}
+
+void SegmentedSearchServer::DeleteFromSegment(Segment& segment, int document_id) {
+    const int slot = *segment.index->FindSlot(document_id);
+    segment.deleted_documents.Add(slot);
+    if (segment.deleted_document_freqs.empty()) {
+        segment.deleted_document_freqs.resize(segment.index->word_to_document_freqs_.GetTermCount());
+    }
+    for (const auto& [term_id, term_freq] : segment.index->documents_.term_freqs[slot]) {
+        ++segment.deleted_document_freqs[term_id];
+    }
+    --segment.live_document_count;
+}
+
+SearchServer SegmentedSearchServer::MakeEmptyIndex(const SearchServer& index) {
+    SearchServer empty_index{std::string_view{}};
+    empty_index.stop_words_ = index.stop_words_;
+    empty_index.SetPostingCompression(index.word_to_document_freqs_.IsCompressed());
+    empty_index.SetPositionIndexing(index.HasPositionIndex());
+    return empty_index;
+}
+
+// Выполняется в фоновом потоке: сегменты-источники не меняются, карты удалённых переданы копиями
+SearchServer SegmentedSearchServer::MergeSegments(SearchServer merged, const std::vector<std::shared_ptr<Segment>>& sources,
+                                                  const std::vector<DocumentBitmap>& deleted_at_start) {
+    std::vector<NewDocument> documents;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const SearchServer& index = *sources[i]->index;
+        for (const int document_id : index) {
+            const int slot = *index.FindSlot(document_id);
+            if (!deleted_at_start[i].Contains(slot)) {
+                documents.push_back({document_id, index.document_texts_.Get(index.documents_.texts[slot]), index.documents_.statuses[slot],
+                                     {index.documents_.ratings[slot]}});
+            }
+        }
+    }
+    merged.AddDocuments(documents);
+    return merged;
+}
+
+void SegmentedSearchServer::SealWriteBuffer() {
+    segments_.push_back(MakeSegment(std::move(write_buffer_)));
+    write_buffer_ = empty_index_;
+}
+
+void SegmentedSearchServer::RunMergePolicy() {
+    if (merge_task_) {
+        if (merge_task_->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return;
+        }
+        InstallMerge();
+    }
+    StartMerge();
+}
+
+void SegmentedSearchServer::InstallMerge() {
+    MergeTask task = std::move(*merge_task_);
+    merge_task_.reset();
+
+    const auto merged = MakeSegment(task.result.get());
+    // Документы, удалённые во время слияния, отмечаются и в новом сегменте
+    for (size_t i = 0; i < task.sources.size(); ++i) {
+        for (const int slot : task.sources[i]->deleted_documents.ToVector()) {
+            if (!task.deleted_at_start[i].Contains(slot)) {
+                DeleteFromSegment(*merged, task.sources[i]->index->documents_.ids[slot]);
+            }
+        }
+    }
+    segments_.erase(std::remove_if(segments_.begin(), segments_.end(), [&task](const auto& segment) {
+        return std::count(task.sources.begin(), task.sources.end(), segment) > 0;
+    }), segments_.end());
+    if (merged->live_document_count > 0) {
+        segments_.push_back(merged);
+    }
+}
+
+void SegmentedSearchServer::StartMerge() {
+    std::vector<std::shared_ptr<Segment>> sources;
+    // Сегмент, где удалённых документов больше, чем живых, переписывается без них
+    for (const auto& segment : segments_) {
+        if (segment->live_document_count * 2 < static_cast<size_t>(segment->index->GetDocumentCount())) {
+            sources.push_back(segment);
+            break;
+        }
+    }
+    // Иначе сливаются MERGE_FACTOR сегментов наименьшего порядка размера, где их набралось столько
+    if (sources.empty()) {
+        std::map<size_t, std::vector<std::shared_ptr<Segment>>> tier_to_segments;
+        for (const auto& segment : segments_) {
+            size_t tier = 0;
+            for (size_t tier_size = buffer_size_ * MERGE_FACTOR; segment->live_document_count >= tier_size; tier_size *= MERGE_FACTOR) {
+                ++tier;
+            }
+            tier_to_segments[tier].push_back(segment);
+        }
+        for (auto& [tier, tier_segments] : tier_to_segments) {
+            if (tier_segments.size() >= MERGE_FACTOR) {
+                tier_segments.resize(MERGE_FACTOR);
+                sources = std::move(tier_segments);
+                break;
+            }
+        }
+    }
+    if (sources.empty()) {
+        return;
+    }
+
+    MergeTask task;
+    task.sources = sources;
+    for (const auto& segment : sources) {
+        task.deleted_at_start.push_back(segment->deleted_documents);
+    }
+    task.result = std::async(std::launch::async, MergeSegments, empty_index_, task.sources, task.deleted_at_start);
+    merge_task_ = std::move(task);
+}
+
+std::vector<double> SegmentedSearchServer::ComputeInverseDocumentFreqs(const std::vector<std::string_view>& words) const {
+    const double log_document_count = log(GetDocumentCount());
+    std::vector<double> inverse_document_freqs;
+    inverse_document_freqs.reserve(words.size());
+    for (const std::string_view word : words) {
+        size_t document_freq = 0;
+        if (const auto term_id = write_buffer_.word_to_document_freqs_.FindTerm(word)) {
+            document_freq += write_buffer_.word_to_document_freqs_.GetDocumentFreq(*term_id);
+        }
+        for (const auto& segment : segments_) {
+            if (const auto term_id = segment->index->word_to_document_freqs_.FindTerm(word)) {
+                document_freq += segment->index->word_to_document_freqs_.GetDocumentFreq(*term_id);
+                if (!segment->deleted_document_freqs.empty()) {
+                    document_freq -= segment->deleted_document_freqs[*term_id];
+                }
+            }
+        }
+        // Та же формула, что в SearchServer, чтобы релевантности совпадали до бита
+        inverse_document_freqs.push_back(log_document_count - log(static_cast<double>(document_freq)));
+    }
+    return inverse_document_freqs;
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <future>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "document_bitmap.h"
+#include "search_server.h"
+
+// Индекс из неизменяемых сегментов в духе LSM-дерева. Новые документы попадают в небольшой буфер записи,
+// заполненный буфер запечатывается в сегмент. Удаление документа из сегмента лишь отмечает его
+// в битовой карте удалённых. Поиск обходит буфер и сегменты с общими для всего индекса IDF и сливает
+// лучшие документы каждого, поэтому результат тот же, что у SearchServer с теми же документами.
+// Мелкие сегменты и сегменты, где удалено больше половины документов, сливаются в фоновом потоке.
+// Как и SearchServer, класс не рассчитан на одновременные вызовы из разных потоков, если хоть один из них меняет индекс
+class SegmentedSearchServer {
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 1024;
+    // Столько сегментов одного порядка размера сливаются в один
+    static constexpr size_t MERGE_FACTOR = 4;
+
+    explicit SegmentedSearchServer(std::string_view stop_words_text, size_t buffer_size = DEFAULT_BUFFER_SIZE);
+    // Документы search_server становятся первым сегментом; новые сегменты получают его стоп-слова и режимы хранения
+    explicit SegmentedSearchServer(SearchServer search_server, size_t buffer_size = DEFAULT_BUFFER_SIZE);
+
+    // Копия делит с оригиналом неизменяемые индексы сегментов и копирует только буфер записи
+    // и отметки удалённых документов. Фоновое слияние остаётся у оригинала
+    SegmentedSearchServer(const SegmentedSearchServer& other);
+    SegmentedSearchServer& operator=(const SegmentedSearchServer&) = delete;
+    SegmentedSearchServer(SegmentedSearchServer&&) = default;
+    SegmentedSearchServer& operator=(SegmentedSearchServer&&) = default;
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    template <typename DocumentPredicate, typename Policy>
+    std::vector<Document> FindTopDocuments(const Policy& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <typename Policy>
+    std::vector<Document> FindTopDocuments(const Policy& policy, std::string_view raw_query, const DocumentFilter& filter,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Слова указывают в сегмент документа и действительны до следующего изменения индекса
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+    int GetDocumentCount() const;
+    size_t GetSegmentCount() const;
+    // Дожидается фоновых слияний и применяет их, пока политика слияния предлагает новые
+    void WaitForMerges();
+    // Запечатывает непустой буфер записи в сегмент, чтобы копии индекса делили с ним все документы
+    void Flush();
+
+private:
+    struct Segment {
+        // Общий для всех копий индекса, которые видят сегмент
+        std::shared_ptr<const SearchServer> index;
+        // Слоты удалённых документов в индексе сегмента
+        DocumentBitmap deleted_documents;
+        // Число удалённых документов с термом, по id терма сегмента; пусто, пока удалений не было
+        std::vector<size_t> deleted_document_freqs;
+        size_t live_document_count;
+    };
+
+    struct MergeTask {
+        std::vector<std::shared_ptr<Segment>> sources;
+        std::vector<DocumentBitmap> deleted_at_start;
+        std::future<SearchServer> result;
+    };
+
+    // Пустой индекс, копии которого становятся буфером записи и результатом слияния
+    SearchServer empty_index_;
+    size_t buffer_size_;
+    SearchServer write_buffer_;
+    std::vector<std::shared_ptr<Segment>> segments_;
+    std::optional<MergeTask> merge_task_;
+
+    std::shared_ptr<Segment> FindSegment(int document_id) const;
+    static std::shared_ptr<Segment> MakeSegment(SearchServer index);
+    static void DeleteFromSegment(Segment& segment, int document_id);
+    static SearchServer MakeEmptyIndex(const SearchServer& index);
+    static SearchServer MergeSegments(SearchServer merged, const std::vector<std::shared_ptr<Segment>>& sources,
+                                      const std::vector<DocumentBitmap>& deleted_at_start);
+
+    void SealWriteBuffer();
+    // Применяет завершённое слияние и запускает следующее, если оно нужно
+    void RunMergePolicy();
+    void InstallMerge();
+    void StartMerge();
+
+    // IDF плюс-слов по всем сегментам без учёта удалённых документов, в порядке слов
+    std::vector<double> ComputeInverseDocumentFreqs(const std::vector<std::string_view>& words) const;
+
+    // search_segment(index, query, deleted_documents) ищет в одном сегменте запрос с общими IDF
+    template <typename SegmentSearch>
+    std::vector<Document> SearchSegments(std::string_view raw_query, SegmentSearch search_segment, size_t max_count) const;
+};
+
+template <typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t max_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_count);
+}
+
+template <typename DocumentPredicate, typename Policy>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(const Policy& policy, std::string_view raw_query, DocumentPredicate document_predicate, size_t max_count) const {
+    static_assert(!search_policy::is_bm25_v<Policy>, "BM25 требует общих для сегментов длин документов");
+    return SearchSegments(raw_query, [&policy, &document_predicate, max_count](const SearchServer& index, const SearchServer::Query& query,
+                                                                           const DocumentBitmap* deleted_documents) {
+        const auto document_checker = [&index, &document_predicate, deleted_documents](int slot) {
+            if (deleted_documents != nullptr && deleted_documents->Contains(slot)) {
+                return false;
+            }
+            return document_predicate(index.documents_.ids[slot], index.documents_.statuses[slot], index.documents_.ratings[slot]);
+        };
+        return index.SearchDocuments(policy, query, document_checker, max_count);
+    }, max_count);
+}
+
+template <typename Policy>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(const Policy& policy, std::string_view raw_query, const DocumentFilter& filter, size_t max_count) const {
+    static_assert(!search_policy::is_bm25_v<Policy>, "BM25 требует общих для сегментов длин документов");
+    return SearchSegments(raw_query, [&policy, &filter, max_count](const SearchServer& index, const SearchServer::Query& query,
+                                                                const DocumentBitmap* deleted_documents) {
+        return index.SearchFilteredDocuments(policy, query, filter, max_count, deleted_documents);
+    }, max_count);
+}
+
+template <typename SegmentSearch>
+std::vector<Document> SegmentedSearchServer::SearchSegments(std::string_view raw_query, SegmentSearch search_segment, size_t max_count) const {
+    const SearchServer::QueryWords query_words = write_buffer_.ParseQueryWords(raw_query);
+    const std::vector<double> inverse_document_freqs = ComputeInverseDocumentFreqs(query_words.plus_words);
+
+    std::vector<Document> top_documents;
+    const auto search_index = [&](const SearchServer& index, const DocumentBitmap* deleted_documents) {
+        SearchServer::Query query = index.MakeQuery(query_words);
+        for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+            const auto word_it = std::lower_bound(query_words.plus_words.begin(), query_words.plus_words.end(),
+                                                  index.word_to_document_freqs_.GetTerm(query.plus_terms[i]));
+            query.inverse_document_freqs[i] = inverse_document_freqs[word_it - query_words.plus_words.begin()];
+        }
+        for (const Document& document : search_segment(index, query, deleted_documents)) {
+            SearchServer::PushTopDocument(top_documents, document, max_count);
+        }
+    };
+    search_index(write_buffer_, nullptr);
+    for (const auto& segment : segments_) {
+        search_index(*segment->index, &segment->deleted_documents);
+    }
+    std::sort_heap(top_documents.begin(), top_documents.end(), SearchServer::IsMoreRelevant);
+    return top_documents;
+}
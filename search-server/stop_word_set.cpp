@@ -0,0 +1,41 @@
+#include "stop_word_set.h"
+
+StopWordSet::StopWordSet(const std::set<std::string, std::less<>>& words)
+        : words_(words.begin(), words.end())
+        , slots_(GetStopWordTableSize(words.size()))
+{
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = 0; i < words_.size(); ++i) {
+        size_t slot = HashStopWord(words_[i]) & mask;
+        while (slots_[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots_[slot] = static_cast<uint32_t>(i + 1);
+    }
+}
+
+bool StopWordSet::Contains(std::string_view word) const {
+    const size_t mask = slots_.size() - 1;
+    for (size_t slot = HashStopWord(word) & mask; slots_[slot] != 0; slot = (slot + 1) & mask) {
+        if (words_[slots_[slot] - 1] == word) {
+            return true;
+        }
+    }
+    return false;
+}
+
+StopWordSet::const_iterator StopWordSet::begin() const {
+    return words_.begin();
+}
+
+StopWordSet::const_iterator StopWordSet::end() const {
+    return words_.end();
+}
+
+size_t StopWordSet::size() const {
+    return words_.size();
+}
+
+bool StopWordSet::empty() const {
+    return words_.empty();
+}
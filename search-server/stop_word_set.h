@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// FNV-1a. constexpr, чтобы таблицу стоп-слов, известных заранее, можно было построить при компиляции
+constexpr uint64_t HashStopWord(std::string_view word) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const char c : word) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Наименьшая степень двойки, не меньше удвоенного числа слов: таблица заполнена не больше чем наполовину
+constexpr size_t GetStopWordTableSize(size_t word_count) {
+    size_t table_size = 1;
+    while (table_size < word_count * 2) {
+        table_size *= 2;
+    }
+    return table_size;
+}
+
+// Стоп-слова, заданные при компиляции. Конструктор сортирует слова, отбрасывает пустые и повторы
+// и раскладывает их по хеш-таблице с линейным пробированием. Слово с управляющим символом
+// в constexpr-контексте даёт ошибку компиляции:
+//     constexpr StaticStopWordSet STOP_WORDS(std::array<std::string_view, 3>{"and", "in", "on"});
+template <size_t N>
+class StaticStopWordSet {
+public:
+    static constexpr size_t TABLE_SIZE = GetStopWordTableSize(N);
+
+    constexpr explicit StaticStopWordSet(const std::array<std::string_view, N>& words);
+
+    constexpr bool Contains(std::string_view word) const;
+
+    // Слова по возрастанию
+    constexpr const std::string_view* begin() const {
+        return words_.data();
+    }
+    constexpr const std::string_view* end() const {
+        return words_.data() + word_count_;
+    }
+    constexpr size_t size() const {
+        return word_count_;
+    }
+
+private:
+    friend class StopWordSet;
+
+    std::array<std::string_view, N> words_{};
+    size_t word_count_ = 0;
+    // Номер слова плюс один, 0 — пустая ячейка
+    std::array<uint32_t, TABLE_SIZE> slots_{};
+};
+
+// Множество стоп-слов для проверки каждого слова документов и запросов.
+// Вместо дерева сравнений — одно хеширование и обычно одно сравнение строк.
+// Обход идёт по словам в порядке возрастания
+class StopWordSet {
+public:
+    using const_iterator = std::vector<std::string>::const_iterator;
+
+    StopWordSet() = default;
+    explicit StopWordSet(const std::set<std::string, std::less<>>& words);
+    // Таблица копируется готовой, слова заново не хешируются
+    template <size_t N>
+    explicit StopWordSet(const StaticStopWordSet<N>& words);
+
+    bool Contains(std::string_view word) const;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    size_t size() const;
+    bool empty() const;
+
+private:
+    std::vector<std::string> words_;
+    // Номер слова плюс один, 0 — пустая ячейка; размер — степень двойки
+    std::vector<uint32_t> slots_ = std::vector<uint32_t>(1);
+};
+
+template <size_t N>
+constexpr StaticStopWordSet<N>::StaticStopWordSet(const std::array<std::string_view, N>& words) {
+    for (const std::string_view word : words) {
+        for (const char c : word) {
+            if (c >= '\0' && c < ' ') {
+                throw std::invalid_argument("Some of stop words are invalid");
+            }
+        }
+        if (word.empty()) {
+            continue;
+        }
+        // Вставка с сохранением порядка; на списках в сотни слов это дёшево даже при компиляции
+        size_t pos = word_count_;
+        while (pos > 0 && word < words_[pos - 1]) {
+            --pos;
+        }
+        if (pos > 0 && words_[pos - 1] == word) {
+            continue;
+        }
+        for (size_t i = word_count_; i > pos; --i) {
+            words_[i] = words_[i - 1];
+        }
+        words_[pos] = word;
+        ++word_count_;
+    }
+    for (size_t i = 0; i < word_count_; ++i) {
+        size_t slot = HashStopWord(words_[i]) & (TABLE_SIZE - 1);
+        while (slots_[slot] != 0) {
+            slot = (slot + 1) & (TABLE_SIZE - 1);
+        }
+        slots_[slot] = static_cast<uint32_t>(i + 1);
+    }
+}
+
+template <size_t N>
+constexpr bool StaticStopWordSet<N>::Contains(std::string_view word) const {
+    for (size_t slot = HashStopWord(word) & (TABLE_SIZE - 1); slots_[slot] != 0; slot = (slot + 1) & (TABLE_SIZE - 1)) {
+        if (words_[slots_[slot] - 1] == word) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <size_t N>
+StopWordSet::StopWordSet(const StaticStopWordSet<N>& words)
+        : words_(words.begin(), words.end())
+        , slots_(words.slots_.begin(), words.slots_.end())
+{}
@@ -0,0 +1,70 @@
+#include "string_arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+StringArena::StringArena(size_t chunk_size)
+        : chunk_size_(chunk_size)
+{}
+
+StringArena::StringArena(const StringArena& other)
+        : chunk_size_(other.chunk_size_)
+        , live_bytes_(other.live_bytes_)
+        , released_bytes_(other.released_bytes_)
+{
+    chunks_.reserve(other.chunks_.size());
+    for (const Chunk& chunk : other.chunks_) {
+        Chunk& copy = chunks_.emplace_back(Chunk{std::make_unique<char[]>(chunk.capacity), chunk.capacity, chunk.size});
+        std::memcpy(copy.data.get(), chunk.data.get(), chunk.size);
+    }
+}
+
+StringArena& StringArena::operator=(const StringArena& other) {
+    if (this != &other) {
+        StringArena copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+StringArena::StringRef StringArena::Add(std::string_view str) {
+    if (chunks_.empty() || chunks_.back().capacity - chunks_.back().size < str.size()) {
+        const size_t capacity = std::max(chunk_size_, str.size());
+        chunks_.push_back({std::make_unique<char[]>(capacity), capacity, 0});
+    }
+    Chunk& chunk = chunks_.back();
+    std::memcpy(chunk.data.get() + chunk.size, str.data(), str.size());
+    const StringRef ref{static_cast<uint32_t>(chunks_.size() - 1), static_cast<uint32_t>(chunk.size),
+                        static_cast<uint32_t>(str.size())};
+    chunk.size += str.size();
+    live_bytes_ += str.size();
+    return ref;
+}
+
+std::string_view StringArena::Get(StringRef ref) const {
+    if (ref.length == 0) {
+        return {};
+    }
+    return {chunks_[ref.chunk].data.get() + ref.offset, ref.length};
+}
+
+void StringArena::Release(StringRef ref) {
+    live_bytes_ -= ref.length;
+    released_bytes_ += ref.length;
+}
+
+size_t StringArena::GetLiveBytes() const {
+    return live_bytes_;
+}
+
+size_t StringArena::GetReleasedBytes() const {
+    return released_bytes_;
+}
+
+size_t StringArena::GetChunkCount() const {
+    return chunks_.size();
+}
+
+bool StringArena::NeedsCompaction() const {
+    return released_bytes_ > live_bytes_ && released_bytes_ >= chunk_size_;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Хранилище строк крупными блоками вместо отдельного выделения памяти под каждую строку.
+// Строки адресуются номером блока и смещением, поэтому ссылки переживают копирование хранилища.
+// Освобождённое место возвращается только при уплотнении
+class StringArena {
+public:
+    struct StringRef {
+        uint32_t chunk;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+    explicit StringArena(size_t chunk_size = DEFAULT_CHUNK_SIZE);
+    StringArena(const StringArena& other);
+    StringArena& operator=(const StringArena& other);
+    StringArena(StringArena&&) = default;
+    StringArena& operator=(StringArena&&) = default;
+
+    StringRef Add(std::string_view str);
+    std::string_view Get(StringRef ref) const;
+    void Release(StringRef ref);
+
+    size_t GetLiveBytes() const;
+    size_t GetReleasedBytes() const;
+    size_t GetChunkCount() const;
+    // Освобождённого места больше, чем занятого, и набрался хотя бы один блок
+    bool NeedsCompaction() const;
+
+private:
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t capacity;
+        size_t size;
+    };
+
+    size_t chunk_size_;
+    std::vector<Chunk> chunks_;
+    size_t live_bytes_ = 0;
+    size_t released_bytes_ = 0;
+};
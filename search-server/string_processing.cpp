@@ -1,18 +1,73 @@
 #include "string_processing.h"
 
-std::vector<std::string_view> SplitIntoWords(std::string_view str) {
-    std::vector<std::string_view> result;
-    const int64_t pos_end = str.npos;
-    
-    while (true) {
-        int64_t space = str.find(' ');
-        result.push_back(space == pos_end ? str.substr(0) : str.substr(0, space));
-        
-        if (space == pos_end) {
-            break;
-        } else {
-            str.remove_prefix(space + 1);
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+bool IsControlChar(char c) {
+    return c >= '\0' && c < ' ';
+}
+
+// Слово, в котором стоит символ text[pos]
+std::string_view GetWordAt(std::string_view text, size_t pos) {
+    const size_t space_before = text.rfind(' ', pos);
+    const size_t first = space_before == text.npos ? 0 : space_before + 1;
+    const size_t last = std::min(text.find(' ', pos), text.size());
+    return text.substr(first, last - first);
+}
+
+// Пробел в позиции pos закрывает слово, начатое в word_start, если оно непустое
+void AddSpace(std::string_view text, size_t pos, size_t& word_start, std::vector<std::string_view>& words) {
+    if (word_start < pos) {
+        words.push_back(text.substr(word_start, pos - word_start));
+    }
+    word_start = pos + 1;
+}
+
+template <bool CheckControlChars>
+std::optional<std::string_view> ScanWords(std::string_view text, std::vector<std::string_view>& words) {
+    size_t word_start = 0;
+    size_t pos = 0;
+#ifdef __SSE2__
+    // По 16 байт за раз: маски пробелов и управляющих символов считаются одним проходом
+    const __m128i spaces = _mm_set1_epi8(' ');
+    const __m128i minus_one = _mm_set1_epi8(-1);
+    for (; pos + 16 <= text.size(); pos += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + pos));
+        if constexpr (CheckControlChars) {
+            // Сравнение знаковое, как у char: байты от 128 отрицательны и управляющими не считаются
+            const __m128i controls = _mm_and_si128(_mm_cmpgt_epi8(chunk, minus_one), _mm_cmplt_epi8(chunk, spaces));
+            if (const int control_mask = _mm_movemask_epi8(controls)) {
+                return GetWordAt(text, pos + __builtin_ctz(control_mask));
+            }
+        }
+        for (int space_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, spaces)); space_mask != 0; space_mask &= space_mask - 1) {
+            AddSpace(text, pos + __builtin_ctz(space_mask), word_start, words);
         }
     }
-    return result;
-}
\ No newline at end of file
+#endif
+    for (; pos < text.size(); ++pos) {
+        if (CheckControlChars && IsControlChar(text[pos])) {
+            return GetWordAt(text, pos);
+        }
+        if (text[pos] == ' ') {
+            AddSpace(text, pos, word_start, words);
+        }
+    }
+    AddSpace(text, text.size(), word_start, words);
+    return std::nullopt;
+}
+
+} // namespace
+
+std::vector<std::string_view> SplitIntoWords(std::string_view text) {
+    std::vector<std::string_view> words;
+    ScanWords<false>(text, words);
+    return words;
+}
+
+std::optional<std::string_view> SplitIntoWords(std::string_view text, std::vector<std::string_view>& words) {
+    return ScanWords<true>(text, words);
+}
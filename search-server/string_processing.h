@@ -1,6 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
+#include <optional>
 #include <set>
 #include <string>
 #include <string_view>
@@ -17,4 +19,9 @@ std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContain
     return non_empty_strings;
 }
 
-std::vector<std::string_view> SplitIntoWords(std::string_view text);
\ No newline at end of file
+// Слова text, разделённые одним или несколькими пробелами; пустых слов нет
+std::vector<std::string_view> SplitIntoWords(std::string_view text);
+
+// Дописывает слова text в words, чтобы один буфер служил многим вызовам. Тем же проходом ищутся
+// управляющие символы (коды 0–31): разбор останавливается на первом слове с ними, и оно возвращается
+std::optional<std::string_view> SplitIntoWords(std::string_view text, std::vector<std::string_view>& words);
@@ -1,7 +1,12 @@
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <stdexcept>
 
 #include "test_example_functions.h"
 #include "log_duration.h"
+#include "process_queries.h"
 
 using namespace std;
 
@@ -56,4 +61,153 @@ void MatchDocuments(const SearchServer& search_server, string_view query) {
     } catch (const exception& e) {
         cout << "Ошибка матчинга документов на запрос "s << query << ": "s << e.what() << endl;
     }
-}
\ No newline at end of file
+}
+
+bool IsSameResult(const vector<Document>& lhs, const vector<Document>& rhs) {
+    return equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Document& a, const Document& b) {
+        return a.id == b.id && a.relevance == b.relevance && a.rating == b.rating;
+    });
+}
+
+// Снимок отвечает на запросы так же, как сервер, с которого он сохранён, включая релевантности до бита
+void TestSnapshotRoundTrip(const SearchServer& search_server, const IndexSnapshot& snapshot, const vector<string>& queries) {
+    int mismatch_count = snapshot.GetDocumentCount() == search_server.GetDocumentCount() ? 0 : 1;
+    for (const string& query : queries) {
+        if (!IsSameResult(search_server.FindTopDocuments(query), snapshot.FindTopDocuments(query))) {
+            ++mismatch_count;
+        }
+    }
+    cout << "snapshot round trip: "s << queries.size() << " queries, mismatches: "s << mismatch_count << endl;
+    if (mismatch_count > 0) {
+        throw logic_error("Снимок отвечает не так, как сервер"s);
+    }
+}
+
+// Снимок с одним изменённым байтом не открывается. Размеры секций в заголовке проверяются
+// и без контрольной суммы, поэтому испорченное число термов отвергается в обоих режимах
+void TestSnapshotRejectsCorruption(const string& snapshot_path) {
+    string bytes;
+    {
+        ifstream in(snapshot_path, ios::binary);
+        bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    const string corrupted_path = snapshot_path + ".corrupted"s;
+    const size_t term_count_high_byte = 39;
+    int accepted_count = 0;
+    int check_count = 0;
+    for (const auto& [position, verify_checksum] : {pair{size_t{0}, true}, pair{size_t{16}, true}, pair{size_t{24}, true},
+                                                   pair{bytes.size() / 2, true}, pair{bytes.size() - 1, true},
+                                                   pair{term_count_high_byte, false}}) {
+        string corrupted = bytes;
+        corrupted[position] ^= 0x40;
+        ofstream(corrupted_path, ios::binary | ios::trunc) << corrupted;
+        ++check_count;
+        try {
+            IndexSnapshot snapshot(corrupted_path, verify_checksum);
+            ++accepted_count;
+        } catch (const runtime_error&) {
+        }
+    }
+    remove(corrupted_path.c_str());
+    cout << "snapshot corruption: "s << check_count << " flipped bytes, accepted: "s << accepted_count << endl;
+    if (accepted_count > 0) {
+        throw logic_error("Открыт повреждённый снимок"s);
+    }
+}
+
+// «a NEAR/k a» требует двух вхождений a не дальше k друг от друга: одно вхождение не пара самому себе.
+// Проверяются и отбор документов по позициям, и MatchDocument
+void TestNearSameWord() {
+    SearchServer search_server("and"s);
+    search_server.SetPositionIndexing(true);
+    search_server.AddDocument(1, "cat sleeps"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "cat chases cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(3, "cat sleeps long and then cat"s, DocumentStatus::ACTUAL, {1});
+    const string query = "cat NEAR/3 cat"s;
+    vector<int> found_ids;
+    for (const Document& document : search_server.FindTopDocuments(query)) {
+        found_ids.push_back(document.id);
+    }
+    vector<int> matched_ids;
+    for (const int document_id : {1, 2, 3}) {
+        if (!get<0>(search_server.MatchDocument(query, document_id)).empty()) {
+            matched_ids.push_back(document_id);
+        }
+    }
+    cout << "near same word: found "s << found_ids.size() << ", matched "s << matched_ids.size() << endl;
+    if (found_ids != vector<int>{2} || matched_ids != vector<int>{2}) {
+        throw logic_error("NEAR/k с одинаковыми словами нашёл не те документы"s);
+    }
+}
+
+// «NEAR/x» с неразобранным расстоянием — обычное слово: запрос не бросает исключение
+// и не требует позиционного индекса
+void TestMalformedNearIsWord() {
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "cat NEAR/x dog"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "cat dog"s, DocumentStatus::ACTUAL, {1});
+    vector<int> found_ids;
+    for (const string& query : {"NEAR/x"s, "-cat NEAR/0"s, "dog NEAR/ -cat"s}) {
+        for (const Document& document : search_server.FindTopDocuments(query)) {
+            found_ids.push_back(document.id);
+        }
+    }
+    cout << "malformed NEAR: found "s << found_ids.size() << endl;
+    if (found_ids != vector<int>{1}) {
+        throw logic_error("Неразобранный NEAR/x обработан не как обычное слово"s);
+    }
+}
+
+// Сервер, где удалено больше половины документов и слоты перенумерованы, отвечает так же,
+// как собранный заново из оставшихся документов. Списки сжаты, позиции включены
+void TestSlotCompaction(const string& stop_words, const vector<string>& documents, const vector<string>& queries) {
+    const int document_count = static_cast<int>(min<size_t>(documents.size(), 3000));
+    SearchServer churned_server(stop_words);
+    SearchServer fresh_server(stop_words);
+    for (SearchServer* search_server : {&churned_server, &fresh_server}) {
+        search_server->SetPostingCompression(true);
+        search_server->SetPositionIndexing(true);
+    }
+    for (int i = 0; i < document_count; ++i) {
+        churned_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {i % 5});
+    }
+    for (int i = 0; i < document_count; ++i) {
+        if (i % 3 != 0) {
+            churned_server.RemoveDocument(i);
+        } else {
+            fresh_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {i % 5});
+        }
+    }
+    for (int i = 0; i < document_count / 3; ++i) {
+        for (SearchServer* search_server : {&churned_server, &fresh_server}) {
+            search_server->AddDocument(document_count + i, documents[i], DocumentStatus::ACTUAL, {i % 5});
+        }
+    }
+
+    vector<string> checked_queries = queries;
+    for (const string& query : queries) {
+        const vector<string_view> words = SplitIntoWords(query);
+        if (words.size() >= 2) {
+            checked_queries.push_back("\""s + string(words[0]) + " "s + string(words[1]) + "\""s);
+        }
+    }
+    int mismatch_count = churned_server.GetDocumentCount() == fresh_server.GetDocumentCount() ? 0 : 1;
+    for (const string& query : checked_queries) {
+        if (!IsSameResult(churned_server.FindTopDocuments(query), fresh_server.FindTopDocuments(query))
+            || !IsSameResult(churned_server.FindTopDocuments(search_policy::max_score, query),
+                             fresh_server.FindTopDocuments(search_policy::max_score, query))) {
+            ++mismatch_count;
+        }
+    }
+    const auto churned_results = ProcessQueries(churned_server, checked_queries);
+    const auto fresh_results = ProcessQueries(fresh_server, checked_queries);
+    for (size_t i = 0; i < checked_queries.size(); ++i) {
+        if (!IsSameResult(churned_results[i], fresh_results[i])) {
+            ++mismatch_count;
+        }
+    }
+    cout << "slot compaction: "s << checked_queries.size() << " queries, mismatches: "s << mismatch_count << endl;
+    if (mismatch_count > 0) {
+        throw logic_error("После перенумерации слотов сервер отвечает иначе"s);
+    }
+}
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include "document.h"
+#include "index_snapshot.h"
 #include "search_server.h"
 
 void PrintDocument(const Document& document);
@@ -8,4 +12,13 @@ void PrintMatchDocumentResult(int document_id, const std::vector<std::string>& w
 void AddDocument(SearchServer& search_server, int document_id, const std::string& document, DocumentStatus status,
                  const std::vector<int>& ratings);
 void FindTopDocuments(const SearchServer& search_server, const std::string& raw_query);
-void MatchDocuments(const SearchServer& search_server, const std::string& query);
\ No newline at end of file
+void MatchDocuments(const SearchServer& search_server, const std::string& query);
+
+bool IsSameResult(const std::vector<Document>& lhs, const std::vector<Document>& rhs);
+// Проверки ниже печатают итог и бросают std::logic_error, если он неверен
+void TestSnapshotRoundTrip(const SearchServer& search_server, const IndexSnapshot& snapshot, const std::vector<std::string>& queries);
+void TestSnapshotRejectsCorruption(const std::string& snapshot_path);
+void TestNearSameWord();
+void TestMalformedNearIsWord();
+void TestSlotCompaction(const std::string& stop_words, const std::vector<std::string>& documents,
+                        const std::vector<std::string>& queries);